@@ -21,6 +21,7 @@
 #include "mpu.h"
 
 #include "platform_memory.h"
+#include "HeapAccounting.h"
 
 unsigned int g_maximumHeapAddress;
 
@@ -360,6 +361,65 @@ static void breakOnHeapOpFromInterruptHandler(void)
 }
 
 extern "C" void *__real_malloc(size_t size);
+extern "C" void *__real_realloc(void *ptr, size_t size);
+extern "C" void __real_free(void *ptr);
+
+#ifdef HEAP_ACCOUNTING
+
+/* Keep two words in front of each allocation, the HeapAccounting tag and a check word. Memory newlib allocates for
+   itself through _malloc_r, eg for strdup, has no header but can still be freed here, the check word tells them apart. */
+#define HEAP_HEADER_SIZE 8
+#define HEAP_CHECK(p, tag) ((uint32_t)(p) ^ (tag) ^ 0x5A3CC3A5)
+
+static void *accountedAlloc(void *p, size_t size)
+{
+    if (!p)
+        return p;
+    uint32_t *pHeader = (uint32_t *)p;
+    pHeader[0] = HeapAccounting::allocated(size, false);
+    pHeader[1] = HEAP_CHECK(pHeader, pHeader[0]);
+    return &pHeader[2];
+}
+
+// returns the start of the chunk to give back to newlib
+static void *accountedFree(void *ptr)
+{
+    uint32_t *pHeader = (uint32_t *)ptr - 2;
+    if (pHeader[1] != HEAP_CHECK(pHeader, pHeader[0]))
+        return ptr;
+    HeapAccounting::freed(pHeader[0], false);
+    pHeader[1] = 0;
+    return pHeader;
+}
+
+extern "C" void *__wrap_malloc(size_t size)
+{
+    breakOnHeapOpFromInterruptHandler();
+    return accountedAlloc(__real_malloc(size + HEAP_HEADER_SIZE), size);
+}
+
+extern "C" void *__wrap_realloc(void *ptr, size_t size)
+{
+    breakOnHeapOpFromInterruptHandler();
+    if (!ptr)
+        return accountedAlloc(__real_malloc(size + HEAP_HEADER_SIZE), size);
+
+    void *chunk = accountedFree(ptr);
+    if (chunk == ptr)
+        return __real_realloc(ptr, size); // not ours
+    // NOTE if this fails the old block is still allocated but no longer counted
+    return accountedAlloc(__real_realloc(chunk, size + HEAP_HEADER_SIZE), size);
+}
+
+extern "C" void __wrap_free(void *ptr)
+{
+    breakOnHeapOpFromInterruptHandler();
+    if (ptr)
+        __real_free(accountedFree(ptr));
+}
+
+#else
+
 extern "C" void *__wrap_malloc(size_t size)
 {
     breakOnHeapOpFromInterruptHandler();
@@ -367,7 +427,6 @@ extern "C" void *__wrap_malloc(size_t size)
 }
 
 
-extern "C" void *__real_realloc(void *ptr, size_t size);
 extern "C" void *__wrap_realloc(void *ptr, size_t size)
 {
     breakOnHeapOpFromInterruptHandler();
@@ -375,11 +434,12 @@ extern "C" void *__wrap_realloc(void *ptr, size_t size)
 }
 
 
-extern "C" void __real_free(void *ptr);
 extern "C" void __wrap_free(void *ptr)
 {
     breakOnHeapOpFromInterruptHandler();
     __real_free(ptr);
 }
 
+#endif // HEAP_ACCOUNTING
+
 #endif // HEAP_TAGS
@@ -10,11 +10,6 @@
 #include "libs/Kernel.h"
 #include "libs/Pin.h"
 #include "libs/ADC/adc.h"
-#include "libs/Pin.h"
-#include "libs/Median.h"
-
-#include <cstring>
-#include <algorithm>
 
 #include "mbed.h"
 
@@ -31,6 +26,12 @@ static void sample_isr(int chan, uint32_t value)
 Adc::Adc()
 {
     instance = this;
+    for (int i = 0; i < num_channels; ++i) {
+        ready[i]= 0;
+#ifdef ADC_IIR_SHIFT
+        iir_state[i]= 0;
+#endif
+    }
     // ADC sample rate need to be fast enough to be able to read the enabled channels within the thermistor poll time
     // even though ther maybe 32 samples we only need one new one within the polling time
     const uint32_t sample_rate= 1000; // 1KHz sample rate
@@ -57,72 +58,60 @@ void Adc::enable_pin(Pin *pin)
 {
     PinName pin_name = this->_pin_to_pinname(pin);
     int channel = adc->_pin_to_channel(pin_name);
-    memset(sample_buffers[channel], 0, sizeof(sample_buffers[0]));
+    windows[channel].clear();
+#ifdef ADC_IIR_SHIFT
+    iir_state[channel]= 0;
+#endif
+    ready[channel]= 0;
 
     this->adc->burst(1);
     this->adc->setup(pin_name, 1);
     this->adc->interrupt_state(pin_name, 1);
 }
 
-// Keeps the last 8 values for each channel
-// This is called in an ISR, so sample_buffers needs to be accessed atomically
-void Adc::new_sample(int chan, uint32_t value)
-{
-    // Shuffle down and add new value to the end
-    if(chan < num_channels) {
-        memmove(&sample_buffers[chan][0], &sample_buffers[chan][1], sizeof(sample_buffers[0]) - sizeof(sample_buffers[0][0]));
-        sample_buffers[chan][num_samples - 1] = (value >> 4) & 0xFFF; // the 12 bit ADC reading
-    }
-}
-
 //#define USE_MEDIAN_FILTER
-// Read the filtered value ( burst mode ) on a given pin
-unsigned int Adc::read(Pin *pin)
+// Called in the ADC ISR for every burst conversion, adds the reading to the channel's window and updates the filtered value
+// so read() does not need to do any work
+void Adc::new_sample(int chan, uint32_t value)
 {
-    PinName p = this->_pin_to_pinname(pin);
-    int channel = adc->_pin_to_channel(p);
+    if(chan >= num_channels) return;
 
-    uint16_t median_buffer[num_samples];
-    // needs atomic access TODO maybe be able to use std::atomic here or some lockless mutex
-    __disable_irq();
-    memcpy(median_buffer, sample_buffers[channel], sizeof(median_buffer));
-    __enable_irq();
+    SortedWindow<num_samples>& w= windows[chan];
+    w.put((value >> 4) & 0xFFF); // the 12 bit ADC reading
 
 #ifdef USE_MEDIAN_FILTER
-    // returns the median value of the last 8 samples
-    return median_buffer[quick_median(median_buffer, num_samples)];
+    // the median value of the window
+    uint32_t v= w.median();
 
 #elif defined(OVERSAMPLE)
     // Oversample to get 2 extra bits of resolution
     // weed out top and bottom worst values then oversample the rest
-    // put into a 4 element moving average and return the average of the last 4 oversampled readings
-    static uint16_t ave_buf[num_channels][4] =  { {0} };
-    std::sort(median_buffer, median_buffer + num_samples);
-    uint32_t sum = 0;
-    for (int i = num_samples / 4; i < (num_samples - (num_samples / 4)); ++i) {
-        sum += median_buffer[i];
-    }
-    // this slows down the rate of change a little bit
-    ave_buf[channel][3]= ave_buf[channel][2];
-    ave_buf[channel][2]= ave_buf[channel][1];
-    ave_buf[channel][1]= ave_buf[channel][0];
-    ave_buf[channel][0]= sum >> OVERSAMPLE;
-    return roundf((ave_buf[channel][0]+ave_buf[channel][1]+ave_buf[channel][2]+ave_buf[channel][3])/4.0F);
+    uint32_t v= w.trimmed_sum() >> OVERSAMPLE;
 
 #else
-    // sort the 8 readings and return the average of the middle 4
-    std::sort(median_buffer, median_buffer + num_samples);
-    int sum = 0;
-    for (int i = num_samples / 4; i < (num_samples - (num_samples / 4)); ++i) {
-        sum += median_buffer[i];
-    }
-    return sum / (num_samples / 2);
+    // the average of the middle half of the readings
+    uint32_t v= w.trimmed_sum() / (num_samples / 2);
+#endif
 
+#ifdef ADC_IIR_SHIFT
+    // this slows down the rate of change a little bit, much like the moving average of the last 4 reads used to
+    iir_state[chan] += ((int32_t)(v << 8) - iir_state[chan]) >> ADC_IIR_SHIFT;
+    ready[chan]= (iir_state[chan] + 128) >> 8;
+#else
+    ready[chan]= v;
 #endif
 }
 
+// Read the filtered value ( burst mode ) on a given pin
+unsigned int Adc::read(Pin *pin) const
+{
+    PinName p = this->_pin_to_pinname(pin);
+    int channel = adc->_pin_to_channel(p);
+    return ready[channel];
+}
+
 // Convert a smoothie Pin into a mBed Pin
-PinName Adc::_pin_to_pinname(Pin *pin)
+PinName Adc::_pin_to_pinname(Pin *pin) const
 {
     if( pin->port == LPC_GPIO0 && pin->pin == 23 ) {
         return p15;
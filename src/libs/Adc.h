@@ -11,8 +11,9 @@
 #define ADC_H
 
 #include "PinNames.h" // mbed.h lib
+#include "SortedWindow.h"
 
-#include <cmath>
+#include <stdint.h>
 
 class Pin;
 namespace mbed {
@@ -23,12 +24,16 @@ namespace mbed {
 // 2 bits means the 12bit ADC is 14 bits of resolution
 #define OVERSAMPLE 2
 
+// the filtered readings go through a first order IIR low pass with a weight of 1/2^n for each new sample
+// comment out to return the trimmed mean of the window directly
+#define ADC_IIR_SHIFT 4
+
 class Adc
 {
 public:
     Adc();
     void enable_pin(Pin *pin);
-    unsigned int read(Pin *pin);
+    unsigned int read(Pin *pin) const;
 
     static Adc *instance;
     void new_sample(int chan, uint32_t value);
@@ -40,18 +45,24 @@ public:
 #endif
 
 private:
-    PinName _pin_to_pinname(Pin *pin);
+    PinName _pin_to_pinname(Pin *pin) const;
     mbed::ADC *adc;
 
     static const int num_channels= 6;
 #ifdef OVERSAMPLE
     // we need 4^n sample to oversample and we get double that to filter out spikes
-    static const int num_samples= powf(4, OVERSAMPLE)*2;
+    static const int num_samples= (1 << (2 * OVERSAMPLE)) * 2;
 #else
     static const int num_samples= 8;
 #endif
-    // buffers storing the last num_samples readings for each channel
-    uint16_t sample_buffers[num_channels][num_samples];
+    // the last num_samples readings for each channel, kept sorted as they arrive
+    SortedWindow<num_samples> windows[num_channels];
+#ifdef ADC_IIR_SHIFT
+    // IIR state with 8 fractional bits
+    int32_t iir_state[num_channels];
+#endif
+    // the filtered value for each channel, written by the ISR and read as a single word so needs no locking
+    volatile uint32_t ready[num_channels];
 };
 
 #endif
@@ -0,0 +1,99 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "BootProfiler.h"
+#include "StreamOutput.h"
+#include "platform_memory.h"
+
+#include "CycleCounter.h"
+#include "system_LPC17xx.h"
+
+#define MAX_ENTRIES 48
+
+extern unsigned int g_maximumHeapAddress;
+extern "C" uint32_t  __malloc_free_list;
+extern "C" uint32_t  _sbrk(int size);
+
+BootProfiler::entry_t *BootProfiler::entries= nullptr;
+uint8_t BootProfiler::nentries= 0;
+uint8_t BootProfiler::depth= 0;
+bool BootProfiler::recording= false;
+
+// the DWT cycle counter is already running, it wraps after about 40 seconds at 100MHz which is plenty for boot
+void BootProfiler::init()
+{
+    entries= (entry_t *)AHB0.alloc(sizeof(entry_t) * MAX_ENTRIES);
+    if(entries == nullptr) return;
+
+    nentries= 0;
+    depth= 0;
+    recording= true;
+}
+
+void BootProfiler::finish()
+{
+    recording= false;
+}
+
+// unused heap above the top of the heap plus whatever is on the malloc free list
+uint32_t BootProfiler::free_heap()
+{
+    uint32_t f= g_maximumHeapAddress - _sbrk(0);
+    // newlib-nano free chunks are the chunk size followed by a pointer to the next free chunk
+    for (uint32_t c = __malloc_free_list; c != 0; c = *(uint32_t *)(c + 4)) {
+        f += *(uint32_t *)c;
+    }
+    return f;
+}
+
+// start timing a phase, the name must be a string literal, returns -1 if not recording or the table is full
+int BootProfiler::begin(const char *name)
+{
+    if(!recording || nentries >= MAX_ENTRIES) return -1;
+
+    entry_t& e= entries[nentries];
+    e.name= name;
+    e.depth= depth++;
+    // these hold the starting values until end() replaces them, AHB0 is only 16K so fits
+    e.heap_free= free_heap();
+    e.heap_used= 0;
+    e.ahb0_used= (int16_t)AHB0.free();
+    // read the counter last so the heap walk is not counted
+    e.cycles= read_cycle_counter();
+    return nentries++;
+}
+
+void BootProfiler::end(int entry)
+{
+    if(entry < 0) return;
+    uint32_t now= read_cycle_counter();
+
+    entry_t& e= entries[entry];
+    e.cycles= now - e.cycles;
+    uint32_t heap= free_heap();
+    e.heap_used= (int16_t)(e.heap_free - heap);
+    e.ahb0_used= (int16_t)(e.ahb0_used - (int32_t)AHB0.free());
+    e.heap_free= heap;
+    depth--;
+}
+
+void BootProfiler::dump(StreamOutput *stream)
+{
+    if(entries == nullptr) {
+        stream->printf("boot profile not available\n");
+        return;
+    }
+
+    uint32_t mhz= SystemCoreClock / 1000000;
+    stream->printf("      us  free heap  heap used  AHB0 used  phase\n");
+    for (int i = 0; i < nentries; ++i) {
+        const entry_t& e= entries[i];
+        stream->printf("%8lu %10lu %10d %10d  %*s%s\n", e.cycles / mhz, e.heap_free, e.heap_used, e.ahb0_used,
+                       e.depth * 2, "", e.name != nullptr ? e.name : "(module)");
+    }
+    if(nentries >= MAX_ENTRIES) stream->printf("table full, later entries were not recorded\n");
+}
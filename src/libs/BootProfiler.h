@@ -0,0 +1,51 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+class StreamOutput;
+
+// Records how long each phase of boot and each module's on_module_loaded takes using the cycle counter,
+// and how much heap and AHB0 each one used.
+// Phases can be nested, anything recorded while a phase is open is shown indented under it.
+// Recording stops when finish() is called at the end of init, the table can then be printed with the bootprof command.
+class BootProfiler {
+    public:
+        static void init();
+        static void finish();
+        static int begin(const char *name);
+        static void end(int entry);
+        static void dump(StreamOutput *stream);
+
+        // times the enclosing scope
+        class Phase {
+            public:
+                Phase(const char *name) { entry= begin(name); }
+                ~Phase() { end(entry); }
+            private:
+                int entry;
+        };
+
+    private:
+        static uint32_t free_heap();
+
+        struct entry_t {
+            const char *name;
+            uint32_t cycles;
+            uint32_t heap_free;     // when the phase ended
+            int16_t heap_used;
+            int16_t ahb0_used;
+            uint8_t depth;
+        };
+
+        static entry_t *entries;
+        static uint8_t nentries;
+        static uint8_t depth;
+        static bool recording;
+};
@@ -142,4 +142,20 @@ int FATFileSystem::mkdir(const char *name, mode_t mode) {
     return res == 0 ? 0 : -1;
 }
 
+// size, date and time from the directory entry, without opening the file
+int FATFileSystem::stat(const char *name, FILINFO *fno) {
+    char n[64];
+    snprintf(n, sizeof(n), "%d:/%s", _fsid, name);
+#if _USE_LFN
+    fno->lfname = NULL;
+    fno->lfsize = 0;
+#endif
+    FRESULT res = f_stat(n, fno);
+    if(res) {
+        FFSDEBUG("f_stat() failed (%d, %s)\n", res, FR_ERRORS[res]);
+        return -1;
+    }
+    return 0;
+}
+
 } // namespace mbed
@@ -43,6 +43,7 @@ public:
     virtual int format();
     virtual DirHandle *opendir(const char *name);
     virtual int mkdir(const char *name, mode_t mode);
+    int stat(const char *name, FILINFO *fno);
 
     FATFS _fs;                                // Work area (file system object) for logical drive
     static FATFileSystem *_ffs[_DRIVES];    // FATFileSystem objects, as parallel to FatFs drives array
@@ -80,6 +80,8 @@ void Config::config_cache_load(bool parse)
         for( ConfigSource *source : this->config_sources ) {
             source->transfer_values_to_cache(this->config_cache);
         }
+        // sort the cache once everything is loaded so lookups are a binary search
+        this->config_cache->build_index();
     }
 }
 
@@ -3,8 +3,23 @@
 
 #include "libs/StreamOutput.h"
 
+#include <algorithm>
+#include <string.h>
+#include <stdlib.h>
+#include <new>
+
+// ConfigValues are allocated from chunks of this size, the whole cache is typically a few of these
+#define ARENA_CHUNK_SIZE 2048
+// number of hash buckets for interned strings, must be a power of 2
+#define STRING_BUCKETS 64
+
 ConfigCache::ConfigCache()
 {
+    chunks= nullptr;
+    strings= nullptr;
+    nstrings= 0;
+    nshared= 0;
+    indexed= false;
 }
 
 ConfigCache::~ConfigCache()
@@ -14,49 +29,199 @@ ConfigCache::~ConfigCache()
 
 void ConfigCache::clear()
 {
-    for (auto &kv : store)  {
-        delete kv;
-    }
     store.clear();
     storage_t().swap(store);   //  makes sure the vector releases its memory
+    index_t().swap(index);
+    indexed= false;
+
+    // ConfigValues are trivially destructible so the arena can just be released in one go
+    while(chunks != nullptr) {
+        chunk_t *next= chunks->next;
+        free(chunks);
+        chunks= next;
+    }
+    strings= nullptr;
+    nstrings= 0;
+    nshared= 0;
+}
+
+// bump allocate from the current chunk, starting a new one when it is full, allocations are word aligned
+void *ConfigCache::arena_alloc(size_t size)
+{
+    size= (size + 3) & ~3;
+    if(chunks == nullptr || chunks->used + size > chunks->size) {
+        size_t n= size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+        chunk_t *c= (chunk_t *)malloc(sizeof(chunk_t) + n);
+        if(c == nullptr) return nullptr;
+        c->next= chunks;
+        c->size= n;
+        c->used= 0;
+        chunks= c;
+    }
+    void *p= (char *)(chunks + 1) + chunks->used;
+    chunks->used += size;
+    return p;
+}
+
+// return the arena copy of str, which is shared with any identical string already interned
+const char *ConfigCache::intern(const char *str, size_t len)
+{
+    if(strings == nullptr) {
+        strings= (interned_t **)arena_alloc(sizeof(interned_t *) * STRING_BUCKETS);
+        if(strings == nullptr) return nullptr;
+        memset(strings, 0, sizeof(interned_t *) * STRING_BUCKETS);
+    }
+
+    // FNV-1a
+    uint32_t hash= 2166136261UL;
+    for (size_t i = 0; i < len; ++i) {
+        hash= (hash ^ (uint8_t)str[i]) * 16777619UL;
+    }
+    interned_t **bucket= &strings[hash & (STRING_BUCKETS - 1)];
+
+    for (interned_t *i = *bucket; i != nullptr; i = i->next) {
+        if(strncmp(i->str, str, len) == 0 && i->str[len] == '\0') {
+            nshared++;
+            return i->str;
+        }
+    }
+
+    interned_t *n= (interned_t *)arena_alloc(sizeof(interned_t) + len + 1);
+    if(n == nullptr) return nullptr;
+    memcpy(n->str, str, len);
+    n->str[len]= '\0';
+    n->next= *bucket;
+    *bucket= n;
+    nstrings++;
+    return n->str;
+}
+
+ConfigValue *ConfigCache::new_value(const uint16_t *check_sums, const char *value, size_t len)
+{
+    void *v= arena_alloc(sizeof(ConfigValue));
+    const char *s= intern(value, len);
+    if(v == nullptr || s == nullptr) {
+        printf("ERROR: out of memory loading config\n");
+        return nullptr;
+    }
+
+    ConfigValue *cv= new(v) ConfigValue(const_cast<uint16_t *>(check_sums));
+    cv->found= true;
+    cv->value= s;
+    return cv;
 }
 
-void ConfigCache::add(ConfigValue *v)
+ConfigValue *ConfigCache::add(const uint16_t *check_sums, const char *value, size_t len)
 {
-    store.push_back(v);
+    ConfigValue *cv= new_value(check_sums, value, len);
+    if(cv == nullptr) return nullptr;
+    store.push_back(cv);
+    indexed= false;
+    return cv;
 }
 
+// the memory stays in the arena until the cache is cleared
 void ConfigCache::pop()
 {
-    auto cv= store.back();
     store.pop_back();
-    delete cv;
+    indexed= false;
 }
 
-// If we find an existing value, replace it, otherwise, push it at the back of the list
-void ConfigCache::replace_or_push_back(ConfigValue *new_value)
-{
-    // For each already existing element
-    for(auto &cv : store) {
-        // If this configvalue matches the checksum
-        if(memcmp(new_value->check_sums, cv->check_sums, sizeof(cv->check_sums)) == 0) {
-            // Replace with the provided value
-            delete cv; // free up old one
-            cv =  new_value;
-            printf("WARNING: duplicate config line replaced\n");
-            return;
+// orders the index by the three checksums, which is the same as ordering by the 48 bit key made from them
+static inline bool key_less(const uint16_t *a, const uint16_t *b)
+{
+    if(a[0] != b[0]) return a[0] < b[0];
+    if(a[1] != b[1]) return a[1] < b[1];
+    return a[2] < b[2];
+}
+
+void ConfigCache::sort_index()
+{
+    index.resize(store.size());
+    for (size_t i = 0; i < store.size(); ++i) {
+        index[i]= i;
+    }
+    // stable so duplicates stay in the order they were added
+    std::stable_sort(index.begin(), index.end(), [this](uint16_t a, uint16_t b) { return key_less(store[a]->check_sums, store[b]->check_sums); });
+}
+
+// Values are added unsorted while the config is being read, this sorts them so lookup can do a binary search.
+// Duplicates are resolved here rather than as each value is added, which would be a linear search per line,
+// the last value found wins but it keeps the place of the first so the order modules are found in does not change
+void ConfigCache::build_index()
+{
+    sort_index();
+
+    bool dups= false;
+    for (size_t i = 0; i < index.size(); ) {
+        size_t j= i + 1;
+        while(j < index.size() && memcmp(store[index[i]]->check_sums, store[index[j]]->check_sums, sizeof(store[0]->check_sums)) == 0) {
+            ++j;
+        }
+        if(j - i > 1) {
+            // index[j-1] is the last one added
+            ConfigValue *last= store[index[j - 1]];
+            store[index[j - 1]]= nullptr;
+            for (size_t k = i; k < j - 1; ++k) {
+                store[index[k]]= nullptr;
+                printf("WARNING: duplicate config line replaced\n");
+            }
+            store[index[i]]= last;
+            dups= true;
         }
+        i= j;
+    }
+
+    if(dups) {
+        store.erase(std::remove(store.begin(), store.end(), nullptr), store.end());
+        sort_index();
+    }
+
+    indexed= true;
+}
+
+// If we find an existing value, replace it, otherwise, push it at the back of the list
+ConfigValue *ConfigCache::replace_or_push_back(const uint16_t *check_sums, const char *value, size_t len)
+{
+    if(!indexed) {
+        // still loading, duplicates get sorted out by build_index
+        return add(check_sums, value, len);
+    }
+
+    auto i= lower_bound(check_sums[0], check_sums[1], check_sums[2]);
+    if(i != index.end() && memcmp(check_sums, store[*i]->check_sums, sizeof(store[0]->check_sums)) == 0) {
+        // Replace with the provided value, the old one stays in the arena
+        ConfigValue *cv= new_value(check_sums, value, len);
+        if(cv == nullptr) return nullptr;
+        store[*i]= cv;
+        printf("WARNING: duplicate config line replaced\n");
+        return cv;
     }
 
     // Value does not already exists, add to the list
-    store.push_back(new_value);
+    return add(check_sums, value, len);
+}
+
+// first entry in the index that is not less than the given checksums
+ConfigCache::index_t::const_iterator ConfigCache::lower_bound(uint16_t cs0, uint16_t cs1, uint16_t cs2) const
+{
+    const uint16_t key[3]= {cs0, cs1, cs2};
+    return std::lower_bound(index.begin(), index.end(), key, [this](uint16_t a, const uint16_t *k) { return key_less(store[a]->check_sums, k); });
 }
 
 ConfigValue *ConfigCache::lookup(const uint16_t *check_sums) const
 {
-    for( auto &cv : store) {
-        if(memcmp(check_sums, cv->check_sums, sizeof(cv->check_sums)) == 0)
-            return cv;
+    if(indexed) {
+        auto i= lower_bound(check_sums[0], check_sums[1], check_sums[2]);
+        if(i != index.end() && memcmp(check_sums, store[*i]->check_sums, sizeof(store[0]->check_sums)) == 0)
+            return store[*i];
+        return NULL;
+    }
+
+    // not sorted yet so search from the end, as the last one added is the one that counts
+    for (auto i = store.rbegin(); i != store.rend(); ++i) {
+        if(memcmp(check_sums, (*i)->check_sums, sizeof((*i)->check_sums)) == 0)
+            return *i;
     }
 
     return NULL;
@@ -64,12 +229,22 @@ ConfigValue *ConfigCache::lookup(const uint16_t *check_sums) const
 
 void ConfigCache::collect(uint16_t family, uint16_t cs, vector<uint16_t> *list)
 {
-    for( auto &kv : store ) {
-        if( kv->check_sums[2] == cs && kv->check_sums[0] == family ) {
-            // We found a module enable for this family, add it's number
-            list->push_back(kv->check_sums[1]);
+    if(!indexed) build_index();
+
+    // all entries of the family are together in the index, find the ones that are enabled
+    vector<uint16_t> found;
+    for (auto i = lower_bound(family, 0, 0); i != index.end() && store[*i]->check_sums[0] == family; ++i) {
+        if( store[*i]->check_sums[2] == cs ) {
+            found.push_back(*i);
         }
     }
+
+    // return them in the order they were found in the config
+    std::sort(found.begin(), found.end());
+    for (auto i : found) {
+        // We found a module enable for this family, add it's number
+        list->push_back(store[i]->check_sums[1]);
+    }
 }
 
 void ConfigCache::dump(StreamOutput *stream)
@@ -78,6 +253,13 @@ void ConfigCache::dump(StreamOutput *stream)
     for( auto &kv : store ) {
         ConfigValue *v = kv;
         stream->printf("%3d - %04X %04X %04X : '%s' - found: %d, default: %d, default-double: %f, default-int: %d\n",
-                       l++, v->check_sums[0], v->check_sums[1], v->check_sums[2], v->value.c_str(), v->found, v->default_set, v->default_double, v->default_int );
+                       l++, v->check_sums[0], v->check_sums[1], v->check_sums[2], v->value, v->found, v->default_set, v->default_double, v->default_int );
+    }
+
+    size_t n= 0, used= 0;
+    for (chunk_t *c = chunks; c != nullptr; c = c->next) {
+        n++;
+        used += c->used;
     }
+    stream->printf("arena: %u bytes used in %u chunks, %u strings, %u shared\n", used, n, nstrings, nshared);
 }
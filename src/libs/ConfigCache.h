@@ -11,6 +11,7 @@
 using namespace std;
 #include <vector>
 #include <stdint.h>
+#include <stddef.h>
 #include <map>
 
 class ConfigValue;
@@ -22,7 +23,8 @@ class ConfigCache {
         ~ConfigCache();
         void clear();
 
-        void add(ConfigValue* v);
+        // ConfigValues and their strings are allocated from an arena owned by the cache and all released by clear()
+        ConfigValue *add(const uint16_t *check_sums, const char *value, size_t len);
         void pop();
 
         // lookup and return the entru that matches the check sums,return NULL if not found
@@ -32,14 +34,47 @@ class ConfigCache {
         void collect(uint16_t family, uint16_t cs, vector<uint16_t> *list);
 
         // If we find an existing value, replace it, otherwise, push it at the back of the list
-        void replace_or_push_back(ConfigValue* new_value);
+        ConfigValue *replace_or_push_back(const uint16_t *check_sums, const char *value, size_t len);
+
+        // sort the values for fast lookup, removes duplicates keeping the last one, call once all values have been added
+        void build_index();
+
+        // access to the values in the order they were added
+        size_t size() const { return store.size(); }
+        ConfigValue *at(size_t i) const { return store[i]; }
 
         // used for debugging, dumps the cache to a stream
         void dump(StreamOutput *stream);
 
     private:
         typedef vector<ConfigValue*> storage_t;
-        storage_t store;
+        typedef vector<uint16_t> index_t;
+        void sort_index();
+        index_t::const_iterator lower_bound(uint16_t cs0, uint16_t cs1, uint16_t cs2) const;
+        ConfigValue *new_value(const uint16_t *check_sums, const char *value, size_t len);
+        void *arena_alloc(size_t size);
+        const char *intern(const char *str, size_t len);
+
+        // a chunk of the arena, the memory handed out follows the header
+        struct chunk_t {
+            chunk_t *next;
+            size_t size;
+            size_t used;
+        };
+
+        // interned strings are kept in a small hash table so identical values (pin names, true/false etc) are only stored once
+        struct interned_t {
+            interned_t *next;
+            char str[];
+        };
+
+        storage_t store;    // values in the order they were found in the config
+        index_t index;      // positions in store sorted by checksums, only valid when indexed is set
+        chunk_t *chunks;
+        interned_t **strings;
+        uint16_t nstrings;
+        uint16_t nshared;
+        bool indexed;
 };
 
 
@@ -9,6 +9,8 @@
 #define CONFIGSOURCE_H
 
 #include <string>
+#include <stdint.h>
+#include <stddef.h>
 
 class ConfigValue;
 class ConfigCache;
@@ -30,7 +32,7 @@ class ConfigSource {
         uint16_t name_checksum;
 
     private:
-        ConfigValue* process_line(const std::string &buffer);
+        bool process_line(const std::string &buffer, uint16_t check_sums[3], size_t& begin_value, size_t& value_len);
 };
 
 
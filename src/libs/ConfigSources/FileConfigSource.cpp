@@ -11,19 +11,50 @@
 #include "ConfigCache.h"
 #include "checksumm.h"
 #include "utils.h"
+#include "FATFileSystem.h"
 #include <malloc.h>
 
 using namespace std;
 #include <string>
 #include <string.h>
+#include <map>
 
 #define include_checksum     CHECKSUM("include")
 
+// The binary snapshot of a config file is saved next to it as <config file>.snap, and is used instead of parsing
+// the text as long as the config file and any files it includes are unchanged since it was made.
+// That is checked from the size and write time in their directory entries, so they are not read at all. Files we wrote
+// ourselves all get the same time from get_fattime(), with a date of 0, so for those the contents are hashed too
+#define SNAPSHOT_SUFFIX  ".snap"
+#define SNAPSHOT_MAGIC   0x47464353 // SCFG
+#define SNAPSHOT_VERSION 2
+
+struct snapshot_header_t {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t nfiles;
+    uint32_t nvalues;
+    uint32_t pool_size;
+};
+
+struct snapshot_file_t {
+    uint32_t size;
+    uint32_t stamp; // FAT date << 16 | time, 0 if it is not on a FAT file system
+    uint32_t hash;
+    char name[52];
+};
+
+struct snapshot_value_t {
+    uint16_t check_sums[3];
+    uint16_t offset; // of the nul terminated value in the string pool, identical values are only stored once
+};
+
 FileConfigSource::FileConfigSource(string config_file, const char *name)
 {
     this->name_checksum = get_checksum(name);
     this->config_file = config_file;
     this->config_file_found = false;
+    this->include_missing = false;
 }
 
 bool FileConfigSource::readLine(string& line, int lineno, FILE *fp)
@@ -55,7 +86,182 @@ void FileConfigSource::transfer_values_to_cache( ConfigCache *cache )
     if( !this->has_config_file() ) {
         return;
     }
+
+    string snapshot_file= this->get_config_file() + SNAPSHOT_SUFFIX;
+    if(load_snapshot(cache, snapshot_file)) return;
+
+    // snapshot is missing or out of date, so parse the text and make a new one
+    size_t first= cache->size();
+    this->included_files.clear();
+    this->include_missing= false;
     transfer_values_to_cache( cache, this->get_config_file().c_str());
+    // we can't tell if a missing include file turns up later, so only make a snapshot if they were all found
+    if(!this->include_missing) save_snapshot(cache, first, snapshot_file);
+}
+
+// size and FNV-1a hash of a files contents
+bool FileConfigSource::hash_file(const char *file_name, uint32_t& size, uint32_t& hash)
+{
+    FILE *fp = fopen(file_name, "r");
+    if(fp == NULL) return false;
+
+    uint8_t buf[512];
+    size= 0;
+    hash= 2166136261UL;
+    size_t n;
+    while((n= fread(buf, 1, sizeof(buf), fp)) > 0) {
+        for (size_t i = 0; i < n; ++i) {
+            hash= (hash ^ buf[i]) * 16777619UL;
+        }
+        size += n;
+    }
+    fclose(fp);
+    return true;
+}
+
+// size and FAT date and time of a file from its directory entry, false if it is not on a FAT file system, eg /local
+bool FileConfigSource::stat_file(const char *file_name, uint32_t& size, uint32_t& stamp)
+{
+    // the file system is named by the first part of the path, eg sd in /sd/config
+    if(file_name[0] != '/') return false;
+    const char *name= strchr(file_name + 1, '/');
+    if(name == NULL) return false;
+    mbed::FileBase *fs= mbed::FileBase::lookup(file_name + 1, name - file_name - 1);
+
+    for (int i = 0; i < _DRIVES; ++i) {
+        mbed::FATFileSystem *ffs= mbed::FATFileSystem::_ffs[i];
+        if(ffs == NULL || ffs != fs) continue;
+
+        FILINFO fno;
+        if(ffs->stat(name + 1, &fno) != 0) return false;
+        size= fno.fsize;
+        stamp= ((uint32_t)fno.fdate << 16) | fno.ftime;
+        return true;
+    }
+    return false;
+}
+
+// true if a file is the same as when its entry in the snapshot was made
+bool FileConfigSource::file_unchanged(const char *file_name, uint32_t size, uint32_t stamp, uint32_t hash)
+{
+    uint32_t fsize, fstamp, fhash;
+    if(stat_file(file_name, fsize, fstamp)) {
+        if(fsize != size) return false;
+        // a real date is from the host and is changed by every write, so the contents are the same
+        if(fstamp == stamp && (fstamp >> 16) != 0) return true;
+    }
+
+    // written by us, or the stamp has changed but maybe not the contents
+    return hash_file(file_name, fsize, fhash) && fsize == size && fhash == hash;
+}
+
+// add the values from the snapshot to the cache, returns false if there is no snapshot or it is out of date
+bool FileConfigSource::load_snapshot(ConfigCache *cache, const string& snapshot_file)
+{
+    FILE *fp = fopen(snapshot_file.c_str(), "r");
+    if(fp == NULL) return false;
+
+    // read the whole thing in one go
+    fseek(fp, 0, SEEK_END);
+    long size= ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if(size < (long)sizeof(snapshot_header_t)) {
+        fclose(fp);
+        return false;
+    }
+    char *buf= (char *)malloc(size);
+    if(buf == NULL) {
+        fclose(fp);
+        return false;
+    }
+    bool ok= fread(buf, 1, size, fp) == (size_t)size;
+    fclose(fp);
+
+    // check the counts against the size read before using them, a truncated or corrupt snapshot must not lead outside buf
+    const snapshot_header_t *header= (const snapshot_header_t *)buf;
+    ok= ok && header->magic == SNAPSHOT_MAGIC && header->version == SNAPSHOT_VERSION && header->nfiles > 0 &&
+        header->nvalues <= (uint32_t)size / sizeof(snapshot_value_t) && header->pool_size <= (uint32_t)size &&
+        (long)(sizeof(snapshot_header_t) + header->nfiles * sizeof(snapshot_file_t) + header->nvalues * sizeof(snapshot_value_t) + header->pool_size) == size;
+
+    const snapshot_file_t *files= (const snapshot_file_t *)(buf + sizeof(snapshot_header_t));
+    const snapshot_value_t *values= (const snapshot_value_t *)(files + (ok ? header->nfiles : 0));
+    const char *pool= (const char *)(values + (ok ? header->nvalues : 0));
+
+    // every value has to be a string that ends inside the pool
+    ok= ok && (header->nvalues == 0 || (header->pool_size > 0 && pool[header->pool_size - 1] == '\0'));
+    for (uint32_t i = 0; ok && i < header->nvalues; ++i) {
+        ok= values[i].offset < header->pool_size;
+    }
+
+    // the config file and all its includes must be unchanged
+    for (uint16_t i = 0; ok && i < header->nfiles; ++i) {
+        ok= memchr(files[i].name, '\0', sizeof(files[i].name)) != NULL &&
+            file_unchanged(files[i].name, files[i].size, files[i].stamp, files[i].hash);
+    }
+
+    if(ok) {
+        for (uint32_t i = 0; i < header->nvalues; ++i) {
+            const char *v= &pool[values[i].offset];
+            cache->add(values[i].check_sums, v, strlen(v));
+        }
+    }
+
+    free(buf);
+    return ok;
+}
+
+// save the values from first onwards in the cache, which are the ones read from this config file, as a snapshot
+void FileConfigSource::save_snapshot(ConfigCache *cache, size_t first, const string& snapshot_file)
+{
+    vector<string> files;
+    files.push_back(this->get_config_file());
+    files.insert(files.end(), this->included_files.begin(), this->included_files.end());
+
+    snapshot_header_t header;
+    header.magic= SNAPSHOT_MAGIC;
+    header.version= SNAPSHOT_VERSION;
+    header.nfiles= files.size();
+    header.nvalues= cache->size() - first;
+
+    vector<snapshot_file_t> file_entries(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        if(files[i].size() >= sizeof(file_entries[i].name)) return; // too long to store, just parse the text every time
+        memset(file_entries[i].name, 0, sizeof(file_entries[i].name));
+        strcpy(file_entries[i].name, files[i].c_str());
+        if(!hash_file(files[i].c_str(), file_entries[i].size, file_entries[i].hash)) return;
+        uint32_t size;
+        if(!stat_file(files[i].c_str(), size, file_entries[i].stamp)) file_entries[i].stamp= 0;
+    }
+
+    // build the string pool, each distinct value is stored once, values are interned by the cache so the pointer identifies the string
+    string pool;
+    map<const char *, uint16_t> offsets;
+    vector<snapshot_value_t> values(header.nvalues);
+    for (size_t i = 0; i < header.nvalues; ++i) {
+        ConfigValue *cv= cache->at(first + i);
+        memcpy(values[i].check_sums, cv->check_sums, sizeof(values[i].check_sums));
+        auto o= offsets.find(cv->value);
+        if(o == offsets.end()) {
+            size_t len= strlen(cv->value);
+            if(pool.size() + len + 1 > 0xFFFF) return;
+            o= offsets.insert(std::make_pair(cv->value, (uint16_t)pool.size())).first;
+            pool.append(cv->value, len + 1);
+        }
+        values[i].offset= o->second;
+    }
+    header.pool_size= pool.size();
+
+    FILE *fp = fopen(snapshot_file.c_str(), "w");
+    if(fp == NULL) return;
+
+    bool ok= fwrite(&header, sizeof(header), 1, fp) == 1 &&
+             fwrite(file_entries.data(), sizeof(snapshot_file_t), file_entries.size(), fp) == file_entries.size() &&
+             fwrite(values.data(), sizeof(snapshot_value_t), values.size(), fp) == values.size() &&
+             fwrite(pool.data(), 1, pool.size(), fp) == pool.size();
+    fclose(fp);
+
+    // a partial snapshot would fail its size check anyway, but do not leave it around
+    if(!ok) remove(snapshot_file.c_str());
 }
 
 void FileConfigSource::transfer_values_to_cache( ConfigCache *cache, const char * file_name )
@@ -79,7 +285,7 @@ void FileConfigSource::transfer_values_to_cache( ConfigCache *cache, const char
 
             // if this line is an include directive then attempt to read the included file
             if(cv->check_sums[0] == include_checksum) {
-                string inc_file_name = cv->value.c_str();
+                string inc_file_name = cv->value;
                 cache->pop(); // we do not need to keep this around or leave it on the list
 
                 if(!file_exists(inc_file_name)) {
@@ -96,6 +302,7 @@ void FileConfigSource::transfer_values_to_cache( ConfigCache *cache, const char
                 }
                 if(file_exists(inc_file_name)) {
                     printf("Including config file: %s\n", inc_file_name.c_str());
+                    this->included_files.push_back(inc_file_name);
 
                     // save position in current config file
                     fpos_t pos;
@@ -110,6 +317,7 @@ void FileConfigSource::transfer_values_to_cache( ConfigCache *cache, const char
                     fsetpos(lp, &pos);
                 }else{
                     printf("Unable to find included config file: %s\n", inc_file_name.c_str());
+                    this->include_missing= true;
                 }
             }
 
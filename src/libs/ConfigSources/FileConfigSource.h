@@ -14,7 +14,9 @@ class ConfigCache;
 
 using namespace std;
 #include <string>
+#include <vector>
 #include <stdio.h>
+#include <stdint.h>
 
 class FileConfigSource : public ConfigSource
 {
@@ -31,8 +33,16 @@ public:
 
 private:
     bool readLine(string& line, int lineno, FILE *fp);
+    bool load_snapshot(ConfigCache *cache, const string& snapshot_file);
+    void save_snapshot(ConfigCache *cache, size_t first, const string& snapshot_file);
+    static bool hash_file(const char *file_name, uint32_t& size, uint32_t& hash);
+    static bool stat_file(const char *file_name, uint32_t& size, uint32_t& stamp);
+    static bool file_unchanged(const char *file_name, uint32_t size, uint32_t stamp, uint32_t hash);
+
     string config_file;         // Path to the config file
+    vector<string> included_files; // files included by the config file, needed to check the snapshot is still valid
     bool   config_file_found;   // Wether or not the config file's location is known
+    bool   include_missing;     // an included file was not found
 };
 
 
@@ -11,6 +11,10 @@
 
 #include <vector>
 #include <stdio.h>
+#include <string.h>
+
+// Values not found in the config are all the single shared dummy value in Config::value(), so only one default string is ever needed
+static string default_string;
 
 ConfigValue::ConfigValue()
 {
@@ -33,6 +37,8 @@ ConfigValue::ConfigValue(uint16_t *cs) {
     memcpy(this->check_sums, cs, sizeof(this->check_sums));
     this->found = false;
     this->default_set = false;
+    this->default_double= 0.0F;
+    this->default_int= 0;
     this->value= "";
 }
 
@@ -41,7 +47,7 @@ ConfigValue::ConfigValue(const ConfigValue& to_copy)
     this->found = to_copy.found;
     this->default_set = to_copy.default_set;
     memcpy(this->check_sums, to_copy.check_sums, sizeof(this->check_sums));
-    this->value.assign(to_copy.value);
+    this->value= to_copy.value;
 }
 
 ConfigValue& ConfigValue::operator= (const ConfigValue& to_copy)
@@ -50,7 +56,7 @@ ConfigValue& ConfigValue::operator= (const ConfigValue& to_copy)
         this->found = to_copy.found;
         this->default_set = to_copy.default_set;
         memcpy(this->check_sums, to_copy.check_sums, sizeof(this->check_sums));
-        this->value.assign(to_copy.value);
+        this->value= to_copy.value;
     }
     return *this;
 }
@@ -73,7 +79,7 @@ float ConfigValue::as_number()
         const char *cp= str.c_str();
         float result = strtof(cp, &endptr);
         if( endptr <= cp ) {
-            printErrorandExit("config setting with value '%s' and checksums[%04X,%04X,%04X] is not a valid number, please see http://smoothieware.org/configuring-smoothie\r\n", this->value.c_str(), this->check_sums[0], this->check_sums[1], this->check_sums[2] );
+            printErrorandExit("config setting with value '%s' and checksums[%04X,%04X,%04X] is not a valid number, please see http://smoothieware.org/configuring-smoothie\r\n", this->value, this->check_sums[0], this->check_sums[1], this->check_sums[2] );
         }
         return result;
     }
@@ -89,7 +95,7 @@ int ConfigValue::as_int()
         const char *cp= str.c_str();
         int result = strtol(cp, &endptr, 10);
         if( endptr <= cp ) {
-            printErrorandExit("config setting with value '%s' and checksums[%04X,%04X,%04X] is not a valid int, please see http://smoothieware.org/configuring-smoothie\r\n", this->value.c_str(), this->check_sums[0], this->check_sums[1], this->check_sums[2] );
+            printErrorandExit("config setting with value '%s' and checksums[%04X,%04X,%04X] is not a valid int, please see http://smoothieware.org/configuring-smoothie\r\n", this->value, this->check_sums[0], this->check_sums[1], this->check_sums[2] );
         }
         return result;
     }
@@ -105,7 +111,7 @@ bool ConfigValue::as_bool()
     if( this->found == false && this->default_set == true ) {
         return this->default_int;
     } else {
-        return this->value.find_first_of("ty1") != string::npos;
+        return strpbrk(this->value, "ty1") != NULL;
     }
 }
 
@@ -130,13 +136,14 @@ ConfigValue *ConfigValue::by_default(string val)
         return this;
     }
     this->default_set = true;
-    this->value = val;
+    default_string = val;
+    this->value = default_string.c_str();
     return this;
 }
 
 bool ConfigValue::has_characters( const char *mask )
 {
-    if( this->value.find_first_of(mask) != string::npos ) {
+    if( strpbrk(this->value, mask) != NULL ) {
         return true;
     } else {
         return false;
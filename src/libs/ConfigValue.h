@@ -9,6 +9,7 @@
 #define CONFIGVALUE_H
 
 #include <string>
+#include <stdint.h>
 using std::string;
 
 class ConfigValue{
@@ -38,7 +39,7 @@ class ConfigValue{
 
     private:
         bool has_characters( const char* mask );
-        string value;
+        const char *value; // points into the ConfigCache string arena, ConfigValues own no memory
         int default_int;
         float default_double;
         uint16_t check_sums[3];
@@ -0,0 +1,27 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+// The Cortex-M3 DWT cycle counter, accessed by address as the older CMSIS headers used by Pin.h do not define DWT.
+// It counts core clocks so wraps after about 40 seconds at 100MHz.
+#define DWT_CTRL_REG   (*(volatile uint32_t *)0xE0001000)
+#define DWT_CYCCNT_REG (*(volatile uint32_t *)0xE0001004)
+#define DEMCR_REG      (*(volatile uint32_t *)0xE000EDFC)
+
+static inline void enable_cycle_counter()
+{
+    DEMCR_REG |= (1 << 24);     // TRCENA
+    DWT_CTRL_REG |= 1;          // CYCCNTENA
+}
+
+static inline uint32_t read_cycle_counter()
+{
+    return DWT_CYCCNT_REG;
+}
@@ -0,0 +1,125 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "EventProfiler.h"
+#include "StreamOutput.h"
+
+#include "CycleCounter.h"
+#include "system_LPC17xx.h"
+#include "mbed.h"
+
+#include <algorithm>
+#include <string.h>
+
+bool EventProfiler::enabled= false;
+std::vector<EventProfiler::stats_t> EventProfiler::stats;
+std::vector<std::pair<Module*, const char*>> EventProfiler::names;
+uint32_t EventProfiler::enabled_at= 0;
+
+// which slot in stats_t each event uses, or -1 if it is not profiled
+static int event_slot(_EVENT_ENUM event)
+{
+    switch(event) {
+        case ON_MAIN_LOOP: return 0;
+        case ON_IDLE: return 1;
+        case ON_GCODE_RECEIVED: return 2;
+        case ON_SECOND_TICK: return 3;
+        default: return -1;
+    }
+}
+
+static const char *event_names[]= {"main_loop", "idle", "gcode", "second_tick"};
+
+// remember the name given to add_module so it can be printed instead of just the address
+void EventProfiler::set_name(Module *module, const char *name)
+{
+    if(name != nullptr) names.push_back(std::make_pair(module, name));
+}
+
+const char *EventProfiler::get_name(Module *module)
+{
+    for(auto& n : names) {
+        if(n.first == module) return n.second;
+    }
+    return "";
+}
+
+void EventProfiler::enable(bool on)
+{
+    if(on && !enabled) {
+        reset();
+    } else if(!on) {
+        std::vector<stats_t>().swap(stats); // release the memory
+    }
+    enabled= on;
+}
+
+void EventProfiler::reset()
+{
+    stats.clear();
+    enabled_at= us_ticker_read();
+}
+
+uint32_t EventProfiler::begin()
+{
+    return read_cycle_counter();
+}
+
+void EventProfiler::end(Module *module, _EVENT_ENUM event, uint32_t start)
+{
+    // evprof off from inside the handler being timed has freed the stats, so do not start filling them again
+    if(!enabled) return;
+    uint32_t cycles= read_cycle_counter() - start;
+    int slot= event_slot(event);
+    if(slot < 0) return;
+
+    auto i= std::lower_bound(stats.begin(), stats.end(), module, [](const stats_t& s, Module *m) { return s.module < m; });
+    if(i == stats.end() || i->module != module) {
+        // first time we have seen this module
+        stats_t s;
+        memset(&s, 0, sizeof(s));
+        s.module= module;
+        i= stats.insert(i, s);
+    }
+
+    i->cycles[slot] += cycles;
+    i->calls[slot]++;
+    if(cycles > i->max_cycles[slot]) i->max_cycles[slot]= cycles;
+}
+
+// print the n (module, event) pairs that used the most time since the last reset
+void EventProfiler::dump(StreamOutput *stream, int n)
+{
+    if(!enabled) {
+        stream->printf("event profiling is off, use evprof on\n");
+        return;
+    }
+
+    // index of stats entry * NUM_EVENTS + slot
+    std::vector<uint16_t> order;
+    for (size_t i = 0; i < stats.size(); ++i) {
+        for (int e = 0; e < NUM_EVENTS; ++e) {
+            if(stats[i].calls[e] > 0) order.push_back(i * NUM_EVENTS + e);
+        }
+    }
+    std::sort(order.begin(), order.end(), [](uint16_t a, uint16_t b) {
+        return stats[a / NUM_EVENTS].cycles[a % NUM_EVENTS] > stats[b / NUM_EVENTS].cycles[b % NUM_EVENTS];
+    });
+
+    uint32_t mhz= SystemCoreClock / 1000000;
+    // the cycle counter wraps every 40 seconds or so, the totals are 64 bit but the elapsed time needs the us timer
+    uint32_t elapsed= us_ticker_read() - enabled_at;
+    stream->printf("over %lu ms\n", elapsed / 1000);
+    stream->printf("  total us     %%     calls  avg us  max us  event        module\n");
+    for (int i = 0; i < n && i < (int)order.size(); ++i) {
+        const stats_t& s= stats[order[i] / NUM_EVENTS];
+        int e= order[i] % NUM_EVENTS;
+        uint32_t us= (uint32_t)(s.cycles[e] / mhz);
+        stream->printf("%10lu %5.1f %9lu %7lu %7lu  %-12s %p %s\n", us, elapsed > 0 ? 100.0F * us / elapsed : 0.0F, s.calls[e],
+                       us / s.calls[e], s.max_cycles[e] / mhz, event_names[e], s.module, get_name(s.module));
+    }
+}
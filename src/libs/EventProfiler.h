@@ -0,0 +1,46 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Module.h"
+
+#include <stdint.h>
+#include <vector>
+
+class StreamOutput;
+
+// Accumulates the cycles and number of calls spent in each module for the main loop, idle, gcode and second tick events.
+// The kernel only checks enabled before each call so it costs nothing when turned off.
+// Times are inclusive, a module that calls an event from its handler is also charged for the modules it called.
+class EventProfiler {
+    public:
+        static void set_name(Module *module, const char *name);
+        static void enable(bool on);
+        static uint32_t begin();
+        static void end(Module *module, _EVENT_ENUM event, uint32_t start);
+        static void dump(StreamOutput *stream, int n);
+        static void reset();
+
+        static bool enabled;
+
+    private:
+        static const int NUM_EVENTS= 4;
+
+        struct stats_t {
+            Module *module;
+            uint64_t cycles[NUM_EVENTS];
+            uint32_t max_cycles[NUM_EVENTS];
+            uint32_t calls[NUM_EVENTS];
+        };
+
+        static const char *get_name(Module *module);
+
+        static std::vector<stats_t> stats;  // sorted by module
+        static std::vector<std::pair<Module*, const char*>> names;
+        static uint32_t enabled_at; // us
+};
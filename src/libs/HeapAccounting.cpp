@@ -0,0 +1,71 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HeapAccounting.h"
+#include "StreamOutput.h"
+
+#include <string.h>
+
+// the tag is the owner in the top byte and the size in the rest
+#define TAG_SIZE_MASK 0x00FFFFFF
+
+// nothing here may allocate, it is called from inside malloc
+HeapAccounting::owner_t HeapAccounting::owners[MAX_OWNERS]= {{"other", 0, 0, 0, 0, 0}};
+uint8_t HeapAccounting::n_owners= 1;
+uint8_t HeapAccounting::current= 0;
+
+uint8_t HeapAccounting::register_owner(const char *name)
+{
+    if(name == nullptr) return current;
+
+    for (uint8_t i = 0; i < n_owners; ++i) {
+        if(strcmp(owners[i].name, name) == 0) return i;
+    }
+
+    // full, so share the last one
+    if(n_owners == MAX_OWNERS) return MAX_OWNERS - 1;
+
+    owners[n_owners]= {name, 0, 0, 0, 0, 0};
+    return n_owners++;
+}
+
+uint32_t HeapAccounting::allocated(size_t size, bool pool)
+{
+    owner_t& o= owners[current];
+    if(pool) o.pool_bytes += size;
+    else o.heap_bytes += size;
+
+    uint32_t total= o.heap_bytes + o.pool_bytes;
+    if(total > o.peak_bytes) o.peak_bytes= total;
+    if(++o.count > o.peak_count) o.peak_count= o.count;
+
+    return ((uint32_t)current << 24) | (size & TAG_SIZE_MASK);
+}
+
+void HeapAccounting::freed(uint32_t tag, bool pool)
+{
+    owner_t& o= owners[tag >> 24];
+    uint32_t size= tag & TAG_SIZE_MASK;
+    if(pool) o.pool_bytes -= size;
+    else o.heap_bytes -= size;
+    o.count--;
+}
+
+void HeapAccounting::dump(StreamOutput *stream)
+{
+    // printing may allocate, which is charged to whoever is current and can change the numbers while they are shown
+    stream->printf("%-24s %8s %8s %8s %6s %6s\n", "owner", "heap", "ahb", "peak", "allocs", "peak");
+    uint32_t heap= 0, pool= 0;
+    for (uint8_t i = 0; i < n_owners; ++i) {
+        const owner_t& o= owners[i];
+        if(o.peak_count == 0) continue;
+        stream->printf("%-24s %8lu %8lu %8lu %6u %6u\n", o.name, o.heap_bytes, o.pool_bytes, o.peak_bytes, o.count, o.peak_count);
+        heap += o.heap_bytes;
+        pool += o.pool_bytes;
+    }
+    stream->printf("%-24s %8lu %8lu\n", "total", heap, pool);
+}
@@ -0,0 +1,63 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+class StreamOutput;
+
+// Built in with HEAP_ACCOUNTING=1 in the makefile.
+// Every heap and MemoryPool allocation is charged to the owner that is current when it is made, the owner being the module
+// the Kernel is loading or calling an event on. The owner and size are kept in a tag with the allocation so frees are
+// credited back to whoever made it. Allocations made before a module is added, eg in its constructor, go to the owner
+// that was current then, normally "other".
+class HeapAccounting {
+    public:
+        // modules added with the same name share an owner
+        static uint8_t register_owner(const char *name);
+        static uint8_t set_owner(uint8_t owner) { uint8_t o= current; current= owner; return o; }
+        static uint8_t get_owner() { return current; }
+
+        // returns the tag to keep with the allocation
+        static uint32_t allocated(size_t size, bool pool);
+        static void freed(uint32_t tag, bool pool);
+
+        static void dump(StreamOutput *stream);
+
+        // charges everything in scope to owner
+        class Scope {
+            public:
+                Scope(uint8_t owner) { previous= set_owner(owner); }
+                ~Scope() { set_owner(previous); }
+            private:
+                uint8_t previous;
+        };
+
+    private:
+        static const int MAX_OWNERS= 64;
+
+        struct owner_t {
+            const char *name;
+            uint32_t heap_bytes;
+            uint32_t pool_bytes;
+            uint32_t peak_bytes;
+            uint16_t count;
+            uint16_t peak_count;
+        };
+
+        static owner_t owners[MAX_OWNERS];
+        static uint8_t n_owners;
+        static uint8_t current;
+};
+
+#ifdef HEAP_ACCOUNTING
+#define HEAP_OWNER(owner) HeapAccounting::Scope heap_owner_scope(owner)
+#else
+#define HEAP_OWNER(owner) do {} while (0)
+#endif
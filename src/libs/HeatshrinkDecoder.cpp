@@ -0,0 +1,109 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HeatshrinkDecoder.h"
+
+#include <string.h>
+
+// The bitstream is read MSB first and is a sequence of
+//  1 + 8 bits                              literal byte
+//  0 + window_bits + lookahead_bits        copy count+1 bytes from index+1 bytes back in the window
+// the window starts out zeroed, and the last byte is padded with zero bits
+
+HeatshrinkDecoder::HeatshrinkDecoder(uint8_t *window, uint8_t window_bits, uint8_t lookahead_bits)
+{
+    this->window= window;
+    this->window_bits= window_bits;
+    this->lookahead_bits= lookahead_bits;
+    this->window_mask= window_size(window_bits) - 1;
+    reset();
+}
+
+void HeatshrinkDecoder::reset()
+{
+    memset(this->window, 0, window_size(this->window_bits));
+    this->head= 0;
+    this->state= TAG_BIT;
+    this->bits= 0;
+    this->bits_needed= 0;
+    this->bit_mask= 0;
+    this->current_byte= 0;
+    this->backref_index= 0;
+    this->backref_count= 0;
+}
+
+// accumulate n bits into this->bits, returns false if the input ran out first
+// partially read values are kept so it can be called again with more input
+bool HeatshrinkDecoder::get_bits(uint8_t n, const uint8_t *in, size_t in_len, size_t& in_used)
+{
+    if(this->bits_needed == 0) {
+        this->bits_needed= n;
+        this->bits= 0;
+    }
+
+    while(this->bits_needed > 0) {
+        if(this->bit_mask == 0) {
+            if(in_used >= in_len) return false;
+            this->current_byte= in[in_used++];
+            this->bit_mask= 0x80;
+        }
+        this->bits <<= 1;
+        if(this->current_byte & this->bit_mask) this->bits |= 1;
+        this->bit_mask >>= 1;
+        this->bits_needed--;
+    }
+    return true;
+}
+
+// decode as much of in as will fit into out, returns the number of bytes written to out
+// in_used is set to how much of in was consumed, anything not consumed must be passed in again
+size_t HeatshrinkDecoder::decode(const uint8_t *in, size_t in_len, size_t& in_used, uint8_t *out, size_t out_size)
+{
+    size_t n= 0;
+    in_used= 0;
+
+    while(n < out_size) {
+        switch(this->state) {
+            case TAG_BIT:
+                if(!get_bits(1, in, in_len, in_used)) return n;
+                this->state= this->bits ? LITERAL : BACKREF_INDEX;
+                break;
+
+            case LITERAL:
+                if(!get_bits(8, in, in_len, in_used)) return n;
+                this->window[this->head++ & this->window_mask]= this->bits;
+                out[n++]= this->bits;
+                this->state= TAG_BIT;
+                break;
+
+            case BACKREF_INDEX:
+                if(!get_bits(this->window_bits, in, in_len, in_used)) return n;
+                this->backref_index= this->bits + 1;
+                this->state= BACKREF_COUNT;
+                break;
+
+            case BACKREF_COUNT:
+                if(!get_bits(this->lookahead_bits, in, in_len, in_used)) return n;
+                this->backref_count= this->bits + 1;
+                this->state= BACKREF;
+                break;
+
+            case BACKREF:
+                // may be split over several calls if out fills up
+                while(this->backref_count > 0 && n < out_size) {
+                    uint8_t c= this->window[(this->head - this->backref_index) & this->window_mask];
+                    this->window[this->head++ & this->window_mask]= c;
+                    out[n++]= c;
+                    this->backref_count--;
+                }
+                if(this->backref_count == 0) this->state= TAG_BIT;
+                break;
+        }
+    }
+
+    return n;
+}
@@ -0,0 +1,48 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Streaming decoder for the heatshrink LZSS format (https://github.com/atomicobject/heatshrink)
+ * as produced by eg "heatshrink -e -w 11 -l 4 in.gcode out.hs"
+ *
+ * The only memory used is the window of 2^window_bits bytes which is supplied by the caller,
+ * so it can be put in AHB0 or wherever there is room.
+ * Input and output can be fed in chunks of any size, decoding stops when either runs out and
+ * continues from the same place on the next call.
+ */
+class HeatshrinkDecoder {
+    public:
+        HeatshrinkDecoder(uint8_t *window, uint8_t window_bits, uint8_t lookahead_bits);
+
+        void reset();
+        size_t decode(const uint8_t *in, size_t in_len, size_t& in_used, uint8_t *out, size_t out_size);
+
+        static size_t window_size(uint8_t window_bits) { return 1 << window_bits; }
+
+    private:
+        bool get_bits(uint8_t n, const uint8_t *in, size_t in_len, size_t& in_used);
+
+        enum STATE_T {TAG_BIT, LITERAL, BACKREF_INDEX, BACKREF_COUNT, BACKREF};
+
+        uint8_t *window;
+        uint16_t window_mask;
+        uint16_t head;
+        uint16_t backref_index;
+        uint16_t backref_count;
+        uint16_t bits;
+        uint8_t bits_needed;
+        uint8_t current_byte;
+        uint8_t bit_mask;
+        uint8_t window_bits;
+        uint8_t lookahead_bits;
+        STATE_T state;
+};
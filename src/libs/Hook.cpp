@@ -5,4 +5,7 @@ extern "C"{
 
 // Hook is just a glorified FPointer
 
-Hook::Hook(){}
+Hook::Hook(){
+    interval= 0;
+    deadline= 0;
+}
@@ -2,13 +2,19 @@
 #define HOOK_H
 #include "libs/FPointer.h"
 
-// Hook is just a glorified FPointer
+#include <stdint.h>
+#include <functional>
+
+// Hook is just a glorified FPointer, it can also call a std::function
 
 class Hook : public FPointer {
     public:
         Hook();
-        int     interval;
-        int     countdown;
+        void call_hook() { if(function) function(); else call(); }
+
+        std::function<void(void)> function;
+        uint32_t interval;
+        uint32_t deadline;
 };
 
 #endif
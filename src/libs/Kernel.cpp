@@ -11,6 +11,7 @@
 #include "libs/nuts_bolts.h"
 #include "libs/SlowTicker.h"
 #include "libs/Adc.h"
+#include "libs/PwmEngine.h"
 #include "libs/StreamOutputPool.h"
 #include <mri.h>
 #include "checksumm.h"
@@ -20,6 +21,7 @@
 #include "libs/PublicData.h"
 #include "modules/communication/SerialConsole.h"
 #include "modules/communication/GcodeDispatch.h"
+#include "modules/communication/utils/Gcode.h"
 #include "modules/robot/Planner.h"
 #include "modules/robot/Robot.h"
 #include "modules/robot/Conveyor.h"
@@ -35,10 +37,14 @@
 #endif
 
 #include "platform_memory.h"
+#include "BootProfiler.h"
+#include "EventProfiler.h"
+#include "HeapAccounting.h"
 
 #include <malloc.h>
 #include <array>
 #include <string>
+#include <algorithm>
 
 #define laser_checksum CHECKSUM("laser")
 #define baud_rate_setting_checksum CHECKSUM("baud_rate")
@@ -60,6 +66,7 @@ Kernel::Kernel()
     feed_hold = false;
     enable_feed_hold = false;
     bad_mcu= true;
+    gcode_routes_dirty= false;
 
     instance = this; // setup the Singleton instance of the kernel
 
@@ -71,12 +78,15 @@ Kernel::Kernel()
     this->config = new Config();
 
     // Pre-load the config cache, do after setting up serial so we can report errors to serial
+    int p= BootProfiler::begin("config load");
     this->config->config_cache_load();
+    BootProfiler::end(p);
 
     // now config is loaded we can do normal setup for serial based on config
     delete this->serial;
     this->serial = NULL;
 
+    p= BootProfiler::begin("serial");
     this->streams = new StreamOutputPool();
 
     this->current_path   = "/";
@@ -120,13 +130,16 @@ Kernel::Kernel()
     // we expect ok per line now not per G code, setting this to false will return to the old (incorrect) way of ok per G code
     this->ok_per_line = this->config->value( ok_per_line_checksum )->by_default(true)->as_bool();
 
-    this->add_module( this->serial );
+    this->add_module( this->serial, "SerialConsole" );
+    BootProfiler::end(p);
 
     // HAL stuff
-    add_module( this->slow_ticker = new SlowTicker());
+    p= BootProfiler::begin("tickers");
+    add_module( this->slow_ticker = new SlowTicker(), "SlowTicker" );
 
     this->step_ticker = new StepTicker();
     this->adc = new Adc();
+    this->pwm_engine = new PwmEngine();
 
     // TODO : These should go into platform-specific files
     // LPC17xx-specific
@@ -135,7 +148,11 @@ Kernel::Kernel()
     NVIC_SetPriority(TIMER1_IRQn, 1);
     NVIC_SetPriority(TIMER2_IRQn, 4);
     NVIC_SetPriority(TIMER3_IRQn, 4);
+    NVIC_SetPriority(RIT_IRQn, 4);
     NVIC_SetPriority(PendSV_IRQn, 3);
+    // same as the slow ticker the sensor reads are queued from
+    NVIC_SetPriority(SSP0_IRQn, 4);
+    NVIC_SetPriority(SSP1_IRQn, 4);
 
     // Set other priorities lower than the timers
     NVIC_SetPriority(ADC_IRQn, 5);
@@ -161,12 +178,13 @@ Kernel::Kernel()
     // Configure the step ticker
     this->step_ticker->set_frequency( this->base_stepping_frequency );
     this->step_ticker->set_unstep_time( microseconds_per_step_pulse );
+    BootProfiler::end(p);
 
     // Core modules
-    this->add_module( this->conveyor       = new Conveyor()      );
-    this->add_module( this->gcode_dispatch = new GcodeDispatch() );
-    this->add_module( this->robot          = new Robot()         );
-    this->add_module( this->simpleshell    = new SimpleShell()   );
+    this->add_module( this->conveyor       = new Conveyor()     , "Conveyor"      );
+    this->add_module( this->gcode_dispatch = new GcodeDispatch(), "GcodeDispatch" );
+    this->add_module( this->robot          = new Robot()        , "Robot"         );
+    this->add_module( this->simpleshell    = new SimpleShell()  , "SimpleShell"   );
 
     this->planner = new Planner();
     this->configurator = new Configurator();
@@ -305,15 +323,114 @@ std::string Kernel::get_query_string()
 }
 
 // Add a module to Kernel. We don't actually hold a list of modules we just call its on_module_loaded
-void Kernel::add_module(Module* module)
+// the name is only used for the boot profile, modules added by pools are shown under the pool's phase
+void Kernel::add_module(Module* module, const char *name)
 {
+    EventProfiler::set_name(module, name);
+#ifdef HEAP_ACCOUNTING
+    module->heap_owner= HeapAccounting::register_owner(name);
+#endif
+    HEAP_OWNER(module->heap_owner);
+    int p= BootProfiler::begin(name);
     module->on_module_loaded();
+    BootProfiler::end(p);
 }
 
 // Adds a hook for a given module and event
 void Kernel::register_for_event(_EVENT_ENUM id_event, Module *mod)
 {
     this->hooks[id_event].push_back(mod);
+    if(id_event == ON_GCODE_RECEIVED) {
+        // modules that register for the event get every gcode
+        this->gcode_routes.push_back({mod, 0, 0xFFFF, 0});
+        this->gcode_routes_dirty= true;
+    }
+}
+
+// Have on_gcode_received called only for G or M codes first to last inclusive, can be called several times for different codes
+// A module should either do this or register for ON_GCODE_RECEIVED, and it should still check the codes it is given
+void Kernel::register_for_gcode(Module *mod, char letter, uint16_t first, uint16_t last)
+{
+    this->gcode_routes.push_back({mod, first, last, letter});
+    this->gcode_routes_dirty= true;
+}
+
+// Split the codes for one letter into segments where the same modules need to be called, each in the order they registered
+void Kernel::build_gcode_segments(char letter, std::vector<gcode_segment_t>& segments)
+{
+    std::vector<uint16_t> bounds;
+    bounds.push_back(0);
+    for (auto& r : gcode_routes) {
+        if(r.letter != letter) continue;
+        bounds.push_back(r.first);
+        if(r.last < 0xFFFF) bounds.push_back(r.last + 1);
+    }
+    std::sort(bounds.begin(), bounds.end());
+    bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+    segments.clear();
+    for (auto b : bounds) {
+        std::vector<Module*> modules;
+        for (auto& r : gcode_routes) {
+            if((r.letter == 0 || (r.letter == letter && r.first <= b && b <= r.last)) &&
+               std::find(modules.begin(), modules.end(), r.module) == modules.end()) {
+                modules.push_back(r.module);
+            }
+        }
+        // adjacent segments calling the same modules are merged
+        if(!segments.empty() && segments.back().modules == modules) continue;
+        segments.push_back({b, modules});
+    }
+}
+
+void Kernel::build_gcode_routes()
+{
+    build_gcode_segments('G', g_segments);
+    build_gcode_segments('M', m_segments);
+
+    // lines with both a G and M code go to everyone
+    gcode_all.clear();
+    for (auto& r : gcode_routes) {
+        if(std::find(gcode_all.begin(), gcode_all.end(), r.module) == gcode_all.end()) {
+            gcode_all.push_back(r.module);
+        }
+    }
+    gcode_routes_dirty= false;
+}
+
+// Send the gcode to just the modules that want its code, the lookup does not depend on how many modules there are
+// NOTE modules usually register at boot, the routes are rebuilt on the next gcode after any change
+void Kernel::dispatch_gcode(void *argument)
+{
+    if(gcode_routes_dirty) build_gcode_routes();
+
+    Gcode *gcode= static_cast<Gcode*>(argument);
+    const std::vector<Module*> *modules;
+    if(gcode->has_g && gcode->has_m) {
+        modules= &gcode_all;
+
+    } else if(gcode->has_g || gcode->has_m) {
+        const std::vector<gcode_segment_t>& segments= gcode->has_g ? g_segments : m_segments;
+        unsigned int code= gcode->has_g ? gcode->g : gcode->m;
+        // find the last segment starting at or before code, the first segment always starts at 0
+        auto i= std::upper_bound(segments.begin(), segments.end(), code, [](unsigned int c, const gcode_segment_t& seg) { return c < seg.first; });
+        modules= &(i - 1)->modules;
+
+    } else {
+        // only the modules that want every gcode
+        modules= &hooks[ON_GCODE_RECEIVED];
+    }
+
+    for (auto m : *modules) {
+        HEAP_OWNER(m->heap_owner);
+        if(EventProfiler::enabled) {
+            uint32_t t= EventProfiler::begin();
+            m->on_gcode_received(argument);
+            EventProfiler::end(m, ON_GCODE_RECEIVED, t);
+        } else {
+            m->on_gcode_received(argument);
+        }
+    }
 }
 
 // Call a specific event with an argument
@@ -326,9 +443,21 @@ void Kernel::call_event(_EVENT_ENUM id_event, void * argument)
         was_idle = conveyor->is_idle(); // see if we were doing anything like printing
     }
 
-    // send to all registered modules
-    for (auto m : hooks[id_event]) {
-        (m->*kernel_callback_functions[id_event])(argument);
+    if(id_event == ON_GCODE_RECEIVED) {
+        dispatch_gcode(argument);
+
+    } else {
+        // send to all registered modules
+        for (auto m : hooks[id_event]) {
+            HEAP_OWNER(m->heap_owner);
+            if(EventProfiler::enabled) {
+                uint32_t t= EventProfiler::begin();
+                (m->*kernel_callback_functions[id_event])(argument);
+                EventProfiler::end(m, id_event, t);
+            } else {
+                (m->*kernel_callback_functions[id_event])(argument);
+            }
+        }
     }
 
     if(id_event == ON_HALT) {
@@ -350,8 +479,28 @@ bool Kernel::kernel_has_event(_EVENT_ENUM id_event, Module *mod)
     return false;
 }
 
+// Drop the G and M code routes of a module, but not its ON_GCODE_RECEIVED registration, eg when it reads its config again
+void Kernel::unregister_for_gcode(Module *mod)
+{
+    auto e= std::remove_if(gcode_routes.begin(), gcode_routes.end(), [mod](const gcode_route_t& r) { return r.module == mod && r.letter != 0; });
+    if(e != gcode_routes.end()) {
+        gcode_routes.erase(e, gcode_routes.end());
+        gcode_routes_dirty= true;
+    }
+}
+
 void Kernel::unregister_for_event(_EVENT_ENUM id_event, Module *mod)
 {
+    if(id_event == ON_GCODE_RECEIVED) {
+        for (auto i = gcode_routes.begin(); i != gcode_routes.end(); ++i) {
+            if(i->module == mod && i->letter == 0) {
+                gcode_routes.erase(i);
+                gcode_routes_dirty= true;
+                break;
+            }
+        }
+    }
+
     for (auto i = hooks[id_event].begin(); i != hooks[id_event].end(); ++i) {
         if(*i == mod) {
             hooks[id_event].erase(i);
@@ -29,6 +29,7 @@ class Robot;
 class Planner;
 class StepTicker;
 class Adc;
+class PwmEngine;
 class PublicData;
 class SimpleShell;
 class Configurator;
@@ -39,12 +40,14 @@ class Kernel {
         static Kernel* instance; // the Singleton instance of Kernel usable anywhere
         const char* config_override_filename(){ return "/sd/config-override"; }
 
-        void add_module(Module* module);
+        void add_module(Module* module, const char *name= nullptr);
         void register_for_event(_EVENT_ENUM id_event, Module *module);
+        void register_for_gcode(Module *module, char letter, uint16_t first, uint16_t last);
         void call_event(_EVENT_ENUM id_event, void * argument= nullptr);
 
         bool kernel_has_event(_EVENT_ENUM id_event, Module *module);
         void unregister_for_event(_EVENT_ENUM id_event, Module *module);
+        void unregister_for_gcode(Module *module);
 
         bool is_using_leds() const { return use_leds; }
         bool is_halted() const { return halted; }
@@ -73,12 +76,35 @@ class Kernel {
         SlowTicker*       slow_ticker;
         StepTicker*       step_ticker;
         Adc*              adc;
+        PwmEngine*        pwm_engine;
         std::string       current_path;
         uint32_t          base_stepping_frequency;
 
     private:
         // When a module asks to be called for a specific event ( a hook ), this is where that request is remembered
         std::array<std::vector<Module*>, NUMBER_OF_DEFINED_EVENTS> hooks;
+
+        // a module asking for a range of G or M codes, or for all gcodes when letter is 0, in the order they were registered
+        struct gcode_route_t {
+            Module *module;
+            uint16_t first;
+            uint16_t last;
+            char letter;
+        };
+        // the modules to call for codes from first up to the first of the next segment
+        struct gcode_segment_t {
+            uint16_t first;
+            std::vector<Module*> modules;
+        };
+        void dispatch_gcode(void *argument);
+        void build_gcode_routes();
+        void build_gcode_segments(char letter, std::vector<gcode_segment_t>& segments);
+
+        std::vector<gcode_route_t> gcode_routes;
+        std::vector<gcode_segment_t> g_segments;
+        std::vector<gcode_segment_t> m_segments;
+        std::vector<Module*> gcode_all;
+
         struct {
             bool use_leds:1;
             bool halted:1;
@@ -87,6 +113,7 @@ class Kernel {
             bool ok_per_line:1;
             bool enable_feed_hold:1;
             bool bad_mcu:1;
+            bool gcode_routes_dirty:1;
         };
 
 };
@@ -1,6 +1,7 @@
 #include "MemoryPool.h"
 
 #include "StreamOutput.h"
+#include "HeapAccounting.h"
 
 #include <mri.h>
 #include <cstdio>
@@ -36,6 +37,27 @@ typedef struct __attribute__ ((packed))
     uint8_t data[];
 } _poolregion;
 
+// a slab is a used region holding this header followed by n objects of one class.
+// each object has the same header as a region, marked used with the offset of its slab in next,
+// a real region is never this big so dealloc can tell them apart
+struct MemoryPool::slab_t
+{
+    slab_t* prev;
+    slab_t* next;
+    void* free_list;
+    uint16_t used;
+    uint8_t n;
+    uint8_t cls;
+};
+
+#define SLAB_TAG        0x40000000
+// how much to carve from the region for a new slab, always at least one object
+#define SLAB_BYTES      256
+
+// object sizes are about 1.5x apart to keep the rounding waste down
+static const uint16_t class_sizes[] = {16, 24, 32, 48, 64, 96, 128, 192, 256};
+#define class_size(c) (class_sizes[c])
+
 MemoryPool* MemoryPool::first = NULL;
 
 MemoryPool::MemoryPool(void* base, uint16_t size)
@@ -46,6 +68,11 @@ MemoryPool::MemoryPool(void* base, uint16_t size)
     ((_poolregion*) base)->used = 0;
     ((_poolregion*) base)->next = size;
 
+    for (auto& c : classes) {
+        c.partial = NULL;
+        c.carved = c.used = c.high_water = 0;
+    }
+
     // insert ourselves into head of LL
     next = first;
     first = this;
@@ -76,6 +103,144 @@ MemoryPool::~MemoryPool()
 }
 
 void* MemoryPool::alloc(size_t nbytes)
+{
+#ifdef HEAP_ACCOUNTING
+    // the accounting tag goes in front of the allocation
+    uint32_t* t = (uint32_t*) slab_alloc(nbytes + sizeof(uint32_t));
+    if (t == NULL)
+        return NULL;
+    *t = HeapAccounting::allocated(nbytes, true);
+    return t + 1;
+#else
+    return slab_alloc(nbytes);
+#endif
+}
+
+void MemoryPool::dealloc(void* d)
+{
+#ifdef HEAP_ACCOUNTING
+    uint32_t* t = ((uint32_t*) d) - 1;
+    HeapAccounting::freed(*t, true);
+    d = t;
+#endif
+    slab_dealloc(d);
+}
+
+void* MemoryPool::slab_alloc(size_t nbytes)
+{
+    if (nbytes > (size_t)class_size(n_classes - 1))
+        return region_alloc(nbytes);
+
+    // smallest class that fits
+    uint8_t c = 0;
+    while (nbytes > (size_t)class_size(c))
+        c++;
+
+    slab_class_t& sc = classes[c];
+    slab_t* s = sc.partial;
+    if (s == NULL && (s = new_slab(c)) == NULL) {
+        // region is too full or fragmented for a whole slab, fall back to first fit
+        return region_alloc(nbytes);
+    }
+
+    void* d = s->free_list;
+    s->free_list = *(void**) d;
+    if (++s->used == s->n) {
+        // full, it is always at the head of the partial list
+        sc.partial = s->next;
+        if (s->next)
+            s->next->prev = NULL;
+    }
+
+    if (++sc.used > sc.high_water)
+        sc.high_water = sc.used;
+
+    MDEBUG("\tslab %d gave %p\n", class_size(c), d);
+    return d;
+}
+
+void MemoryPool::slab_dealloc(void* d)
+{
+    _poolregion* p = (_poolregion*) (((uint8_t*) d) - sizeof(_poolregion));
+    if (p->used == 0 || (p->next & SLAB_TAG) == 0)
+    {
+        region_dealloc(d);
+        return;
+    }
+
+    slab_t* s = (slab_t*) (((uint8_t*) base) + (p->next & ~SLAB_TAG));
+    slab_class_t& sc = classes[s->cls];
+    sc.used--;
+
+    *(void**) d = s->free_list;
+    s->free_list = d;
+
+    if (s->used-- == s->n)
+    {   // was full, it can give out objects again
+        s->prev = NULL;
+        s->next = sc.partial;
+        if (sc.partial)
+            sc.partial->prev = s;
+        sc.partial = s;
+    }
+
+    // give an empty slab back to the region, unless it is the only one the class has left
+    if (s->used == 0 && (sc.partial != s || s->next != NULL))
+    {
+        if (s->prev)
+            s->prev->next = s->next;
+        else
+            sc.partial = s->next;
+        if (s->next)
+            s->next->prev = s->prev;
+
+        sc.carved -= s->n;
+        MDEBUG("\treleasing slab %p of %d bytes\n", s, class_size(s->cls));
+        region_dealloc(s);
+    }
+}
+
+// carve a slab from the region and put it on the class partial list
+MemoryPool::slab_t* MemoryPool::new_slab(uint8_t c)
+{
+    uint16_t osize = class_size(c) + sizeof(_poolregion);
+    uint16_t n = (SLAB_BYTES - sizeof(slab_t)) / osize;
+    if (n == 0)
+        n = 1;
+
+    slab_t* s = (slab_t*) region_alloc(sizeof(slab_t) + n * osize);
+    if (s == NULL && n > 1) {
+        n = 1;
+        s = (slab_t*) region_alloc(sizeof(slab_t) + osize);
+    }
+    if (s == NULL)
+        return NULL;
+
+    s->free_list = NULL;
+    s->used = 0;
+    s->n = n;
+    s->cls = c;
+    for (uint16_t i = 0; i < n; i++) {
+        _poolregion* p = (_poolregion*) (((uint8_t*) (s + 1)) + i * osize);
+        p->used = 1;
+        p->next = SLAB_TAG | offset(s);
+        *(void**) &p->data = s->free_list;
+        s->free_list = &p->data;
+    }
+
+    slab_class_t& sc = classes[c];
+    s->prev = NULL;
+    s->next = sc.partial;
+    if (sc.partial)
+        sc.partial->prev = s;
+    sc.partial = s;
+    sc.carved += n;
+
+    MDEBUG("\tcarved %d objects of %d bytes at %p\n", n, class_size(c), s);
+    return s;
+}
+
+void* MemoryPool::region_alloc(size_t nbytes)
 {
     // nbytes = ceil(nbytes / 4) * 4
     if (nbytes & 3)
@@ -135,7 +300,7 @@ void* MemoryPool::alloc(size_t nbytes)
     return NULL;
 }
 
-void MemoryPool::dealloc(void* d)
+void MemoryPool::region_dealloc(void* d)
 {
     _poolregion* p = (_poolregion*) (((uint8_t*) d) - sizeof(_poolregion));
     p->used = 0;
@@ -217,13 +382,26 @@ void MemoryPool::debug(StreamOutput* str)
         tot += p->next;
         if (p->used == 0)
             free += p->next;
-        if ((offset(p) + p->next >= size) || (p->next <= sizeof(_poolregion)))
+        if ((offset(p) + p->next >= size) || (p->next == 0))
         {
             str->printf("End: total %lub, free: %lub\n", tot, free);
-            return;
+            break;
         }
         p = (_poolregion*) (((uint8_t*) p) + p->next);
     } while (1);
+
+    str->printf("\tslab  carved  used  high water\n");
+    for (uint8_t c = 0; c < n_classes; c++) {
+        const slab_class_t& sc = classes[c];
+        str->printf("\t%4d  %6u  %4u  %10u\n", class_size(c), sc.carved, sc.used, sc.high_water);
+    }
+
+    uint32_t largest;
+    uint16_t fragments;
+    uint32_t rfree = region_free(largest, fragments);
+    // fragmentation is how much of the free region can not be had in one allocation
+    str->printf("\tregion free: %lub in %u fragments, largest %lub, fragmentation %lu%%\n",
+        rfree, fragments, largest, rfree == 0 ? 0 : 100 - (largest * 100 / rfree));
 }
 
 bool MemoryPool::has(void* p)
@@ -231,18 +409,37 @@ bool MemoryPool::has(void* p)
     return ((p >= base) && (p < (void*) (((uint8_t*) base) + size)));
 }
 
+// free region space plus unused slab objects
 uint32_t MemoryPool::free()
+{
+    uint32_t largest;
+    uint16_t fragments;
+    uint32_t free = region_free(largest, fragments);
+
+    for (uint8_t c = 0; c < n_classes; c++) {
+        free += (classes[c].carved - classes[c].used) * class_size(c);
+    }
+    return free;
+}
+
+uint32_t MemoryPool::region_free(uint32_t& largest, uint16_t& fragments)
 {
     uint32_t free = 0;
+    largest = 0;
+    fragments = 0;
 
     _poolregion* p = (_poolregion*) base;
 
     do {
-        if (p->used == 0)
+        if (p->used == 0) {
             free += p->next;
+            fragments++;
+            if (p->next > largest)
+                largest = p->next;
+        }
         if (offset(p) + p->next >= size)
             return free;
-        if (p->next <= sizeof(_poolregion))
+        if (p->next == 0)
             return free;
         p = (_poolregion*) (((uint8_t*) p) + p->next);
     } while (1);
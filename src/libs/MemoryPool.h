@@ -17,6 +17,10 @@ class StreamOutput;
  * with MUCH thanks to http://www.parashift.com/c++-faq-lite/memory-pools.html
  *
  * test framework at https://gist.github.com/triffid/5563987
+ *
+ * small allocations come from per size class slabs carved from the first fit region, so they are allocated and
+ * freed in constant time however fragmented the region is. empty slabs go back to the region, except the last one
+ * of each class which is kept to avoid thrashing. larger allocations use the first fit region directly.
  */
 
 class MemoryPool
@@ -39,6 +43,25 @@ public:
     static MemoryPool* first;
 
 private:
+    void* slab_alloc(size_t);
+    void  slab_dealloc(void* p);
+    void* region_alloc(size_t);
+    void  region_dealloc(void* p);
+
+    struct slab_t;
+    slab_t* new_slab(uint8_t cls);
+    uint32_t region_free(uint32_t& largest, uint16_t& fragments);
+
+    static const uint8_t n_classes= 9; // 16 to 256 bytes
+
+    struct slab_class_t {
+        slab_t* partial; // slabs with free objects
+        uint16_t carved;
+        uint16_t used;
+        uint16_t high_water;
+    };
+    slab_class_t classes[n_classes];
+
     void* base;
     uint16_t size;
 };
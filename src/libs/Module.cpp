@@ -7,9 +7,17 @@
 
 #include "libs/Module.h"
 #include "libs/Kernel.h"
+#include "libs/PublicData.h"
+#include "libs/HeapAccounting.h"
 
-Module::Module(){}
-Module::~Module(){}
+Module::Module(){
+#ifdef HEAP_ACCOUNTING
+    this->heap_owner= HeapAccounting::get_owner();
+#endif
+}
+Module::~Module(){
+    PublicData::unbind(this);
+}
 
 // this is used to callback the specific method in the Module instance, there must be one for each _EVENT_ENUM and in the same order
 // NOTE this is stored in Flash so takes up no RAM
@@ -32,3 +40,15 @@ void Module::register_for_event(_EVENT_ENUM event_id){
     // You add things to Smoothie by making a new class that inherits the Module class. See http://smoothieware.org/moduleexample for a crude introduction
     THEKERNEL->register_for_event(event_id, this);
 }
+
+void Module::register_for_gcode(char letter, uint16_t first, uint16_t last){
+    THEKERNEL->register_for_gcode(this, letter, first, last);
+}
+
+void Module::unregister_for_gcode(){
+    THEKERNEL->unregister_for_gcode(this);
+}
+
+void Module::register_for_public_data(_EVENT_ENUM event_id, uint16_t csa, uint16_t csb){
+    PublicData::bind(this, event_id, csa, csb);
+}
@@ -8,6 +8,8 @@
 #ifndef MODULE_H
 #define MODULE_H
 
+#include <stdint.h>
+
 // See : http://smoothieware.org/listofevents
 // When adding a new event the virtual method needs to be defined in class Module and the method pointer need to be defined in
 // Module.cpp:16 in the same order
@@ -38,6 +40,13 @@ public:
     virtual void on_module_loaded() {};
 
     void register_for_event(_EVENT_ENUM event_id);
+    // instead of ON_GCODE_RECEIVED, only have on_gcode_received called for these G or M codes
+    void register_for_gcode(char letter, uint16_t first, uint16_t last);
+    void register_for_gcode(char letter, uint16_t code) { register_for_gcode(letter, code, code); }
+    // drop every G or M code registered above, to register different ones
+    void unregister_for_gcode();
+    // instead of ON_GET_PUBLIC_DATA or ON_SET_PUBLIC_DATA, only be asked for requests starting with csa (and csb if not 0)
+    void register_for_public_data(_EVENT_ENUM event_id, uint16_t csa, uint16_t csb= 0);
 
     // event callbacks, not every module will implement all of these
     // there should be one for each _EVENT_ENUM
@@ -51,6 +60,10 @@ public:
     virtual void on_halt(void *) {};
     virtual void on_enable(void *) {};
 
+#ifdef HEAP_ACCOUNTING
+    // what allocations made while the kernel calls this module are charged to
+    uint8_t heap_owner;
+#endif
 };
 
 #endif
@@ -194,7 +194,7 @@ void Network::on_module_loaded()
     // Register for events
     this->register_for_event(ON_IDLE);
     this->register_for_event(ON_MAIN_LOOP);
-    this->register_for_event(ON_GET_PUBLIC_DATA);
+    this->register_for_public_data(ON_GET_PUBLIC_DATA, network_checksum);
 
     this->init();
 }
@@ -2,12 +2,53 @@
 #include "PublicData.h"
 #include "PublicDataRequest.h"
 
+#include <algorithm>
+
+std::vector<PublicData::binding_t> PublicData::bindings;
+
+static bool binding_less(uint8_t event, uint16_t csa, uint8_t e, uint16_t a)
+{
+    return event < e || (event == e && csa < a);
+}
+
+void PublicData::bind(Module *module, _EVENT_ENUM event, uint16_t csa, uint16_t csb)
+{
+    // insert after any existing bindings for the same key so they are called in the order they were bound
+    auto i= std::upper_bound(bindings.begin(), bindings.end(), binding_t{nullptr, csa, 0, (uint8_t)event},
+                             [](const binding_t& a, const binding_t& b) { return binding_less(a.event, a.csa, b.event, b.csa); });
+    bindings.insert(i, binding_t{module, csa, csb, (uint8_t)event});
+}
+
+// a module being deleted must not be called again
+void PublicData::unbind(Module *module)
+{
+    bindings.erase(std::remove_if(bindings.begin(), bindings.end(), [module](const binding_t& b) { return b.module == module; }), bindings.end());
+}
+
+// call the modules bound to the request, returns false if nothing is bound to csa so it needs to be broadcast
+bool PublicData::call_providers(_EVENT_ENUM event, uint16_t csa, uint16_t csb, void *pdr)
+{
+    auto i= std::lower_bound(bindings.begin(), bindings.end(), binding_t{nullptr, csa, 0, (uint8_t)event},
+                             [](const binding_t& a, const binding_t& b) { return binding_less(a.event, a.csa, b.event, b.csa); });
+    if(i == bindings.end() || i->event != event || i->csa != csa) return false;
+
+    // like the broadcast every matching module is called, some requests (eg poll_controls) collect from all of them
+    for (; i != bindings.end() && i->event == event && i->csa == csa; ++i) {
+        if(i->csb == 0 || i->csb == csb) {
+            (i->module->*kernel_callback_functions[event])(pdr);
+        }
+    }
+    return true;
+}
+
 bool PublicData::get_value(uint16_t csa, uint16_t csb, uint16_t csc, void *data) {
     PublicDataRequest pdr(csa, csb, csc);
     // the caller may have created the storage for the returned data so we clear the flag,
     // if it gets set by the callee setting the data ptr that means the data is a pointer to a pointer and is set to a pointer to the returned data
     pdr.set_data_ptr(data, false);
-    THEKERNEL->call_event(ON_GET_PUBLIC_DATA, &pdr );
+    if(!call_providers(ON_GET_PUBLIC_DATA, csa, csb, &pdr)) {
+        THEKERNEL->call_event(ON_GET_PUBLIC_DATA, &pdr );
+    }
     if(pdr.is_taken() && pdr.has_returned_data()) {
         // the callee set the returned data pointer
         *(void**)data= pdr.get_data_ptr();
@@ -18,6 +59,8 @@ bool PublicData::get_value(uint16_t csa, uint16_t csb, uint16_t csc, void *data)
 bool PublicData::set_value(uint16_t csa, uint16_t csb, uint16_t csc, void *data) {
     PublicDataRequest pdr(csa, csb, csc);
     pdr.set_data_ptr(data);
-    THEKERNEL->call_event(ON_SET_PUBLIC_DATA, &pdr );
+    if(!call_providers(ON_SET_PUBLIC_DATA, csa, csb, &pdr)) {
+        THEKERNEL->call_event(ON_SET_PUBLIC_DATA, &pdr );
+    }
     return pdr.is_taken();
 }
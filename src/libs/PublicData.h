@@ -8,6 +8,11 @@
 #ifndef PUBLICDATA_H
 #define PUBLICDATA_H
 
+#include "Module.h"
+
+#include <stdint.h>
+#include <vector>
+
 class PublicData {
     public:
         // there are two ways to get data from a module
@@ -23,6 +28,24 @@ class PublicData {
         static bool set_value(uint16_t csa, uint16_t csb, void *data) { return set_value(csa, csb, 0, data); }
         static bool set_value(uint16_t cs[3], void *data) { return set_value(cs[0], cs[1], cs[2], data); }
         static bool set_value(uint16_t csa, uint16_t csb, uint16_t csc, void *data);
+
+        // A provider binds the requests it answers so they go straight to it instead of being broadcast to every module.
+        // csb of 0 matches any second checksum. Once anything binds a first checksum the requests for it are no longer broadcast,
+        // so every module answering that checksum must bind it.
+        static void bind(Module *module, _EVENT_ENUM event, uint16_t csa, uint16_t csb= 0);
+        static void unbind(Module *module);
+
+    private:
+        static bool call_providers(_EVENT_ENUM event, uint16_t csa, uint16_t csb, void *pdr);
+
+        struct binding_t {
+            Module *module;
+            uint16_t csa;
+            uint16_t csb;
+            uint8_t event;
+        };
+        // sorted by event then csa, in the order they were bound within that
+        static std::vector<binding_t> bindings;
 };
 
 #endif
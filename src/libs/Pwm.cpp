@@ -37,18 +37,18 @@ void Pwm::set(bool value)
     Pin::set(value);
 }
 
-uint32_t Pwm::on_tick(uint32_t dummy)
+// advance the Sigma-Delta one step, returns what the output should be set to, or -1 to leave it alone
+// this does not set the pin so the PwmEngine can write many outputs at once
+int Pwm::sd_step()
 {
     if ((_pwm < 0) || _pwm >= PID_PWM_MAX) {
-        return dummy;
+        return -1;
     }
     else if (_pwm == 0) {
-        Pin::set(false);
-        return dummy;
+        return 0;
     }
     else if (_pwm == PID_PWM_MAX - 1) {
-        Pin::set(true);
-        return dummy;
+        return 1;
     }
 
     /*
@@ -129,7 +129,5 @@ uint32_t Pwm::on_tick(uint32_t dummy)
         if (_sd_accumulator <= 0)
             _sd_direction = false;
     }
-    Pin::set(_sd_direction);
-
-    return dummy;
+    return _sd_direction ? 1 : 0;
 }
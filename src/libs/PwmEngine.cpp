@@ -0,0 +1,105 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PwmEngine.h"
+#include "Pwm.h"
+
+#include "system_LPC17xx.h" // mbed.h lib
+
+#include <algorithm>
+
+#define NUM_PORTS 5
+
+static PwmEngine *global_pwm_engine;
+
+static LPC_GPIO_TypeDef * const gpios[NUM_PORTS]= {LPC_GPIO0, LPC_GPIO1, LPC_GPIO2, LPC_GPIO3, LPC_GPIO4};
+
+PwmEngine::PwmEngine()
+{
+    global_pwm_engine= this;
+    frequency= 0;
+    started= false;
+
+    LPC_SC->PCONP |= (1 << 16);     // Power RIT on
+    LPC_RIT->RICTRL = 0;            // Disabled until started
+    LPC_RIT->RICOUNTER = 0;
+    LPC_RIT->RIMASK = 0;
+}
+
+// the RIT runs from PCLK which defaults to SystemCoreClock/4
+void PwmEngine::set_frequency(uint32_t f)
+{
+    frequency= f;
+    LPC_RIT->RICOMPVAL = (SystemCoreClock >> 2) / frequency;
+    LPC_RIT->RICOUNTER = 0;
+
+    for(auto& c : channels) {
+        c.divider= std::min(65535UL, std::max(1UL, (unsigned long)((frequency + c.frequency / 2) / c.frequency)));
+        c.count= c.divider;
+    }
+}
+
+void PwmEngine::attach(Pwm *pwm, uint32_t f)
+{
+    if(f == 0) return;
+
+    // to avoid race conditions we must stop the interupts before updating this non thread safe vector
+    __disable_irq();
+    channels.push_back({pwm, f, 1, 1});
+    set_frequency(std::max(f, frequency));
+    // attached after start(), the timer may not be running yet
+    if(started) enable_timer();
+    __enable_irq();
+}
+
+void PwmEngine::detach(Pwm *pwm)
+{
+    __disable_irq();
+    channels.erase(std::remove_if(channels.begin(), channels.end(), [pwm](const channel_t& c) { return c.pwm == pwm; }), channels.end());
+    __enable_irq();
+}
+
+void PwmEngine::start()
+{
+    started= true;
+    if(frequency == 0) return; // nothing to do yet, leave the timer off until something is attached
+    enable_timer();
+}
+
+void PwmEngine::enable_timer()
+{
+    LPC_RIT->RICTRL = (1 << 3) | (1 << 1) | 1;  // enable, clear the counter on match, clear the interrupt flag
+    NVIC_EnableIRQ(RIT_IRQn);
+}
+
+void PwmEngine::tick()
+{
+    uint32_t set[NUM_PORTS]= {0};
+    uint32_t clr[NUM_PORTS]= {0};
+
+    for(auto& c : channels) {
+        if(--c.count > 0) continue;
+        c.count= c.divider;
+
+        int v= c.pwm->sd_step();
+        if(v < 0 || !c.pwm->connected()) continue;
+
+        uint32_t mask= 1 << c.pwm->pin;
+        if(c.pwm->is_inverting() ^ (v != 0)) set[(int)c.pwm->port_number] |= mask;
+        else clr[(int)c.pwm->port_number] |= mask;
+    }
+
+    for (int p = 0; p < NUM_PORTS; ++p) {
+        if(set[p] != 0) gpios[p]->FIOSET= set[p];
+        if(clr[p] != 0) gpios[p]->FIOCLR= clr[p];
+    }
+}
+
+extern "C" void RIT_IRQHandler (void){
+    LPC_RIT->RICTRL |= 1;   // clear the interrupt flag
+    global_pwm_engine->tick();
+}
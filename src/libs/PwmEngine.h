@@ -0,0 +1,41 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+class Pwm;
+
+// Runs the sigma-delta outputs of all the heaters and switches from the Repetitive Interrupt Timer.
+// The timer runs at the highest frequency asked for and slower channels are divided down from that,
+// each tick the outputs are collected and then written with one FIOSET and FIOCLR per GPIO port.
+class PwmEngine {
+    public:
+        PwmEngine();
+
+        void attach(Pwm *pwm, uint32_t frequency);
+        void detach(Pwm *pwm);
+        void start();
+        void tick();
+
+    private:
+        void set_frequency(uint32_t frequency);
+        void enable_timer();
+
+        struct channel_t {
+            Pwm *pwm;
+            uint32_t frequency;
+            uint16_t divider;
+            uint16_t count;
+        };
+
+        std::vector<channel_t> channels;
+        uint32_t frequency;
+        bool started; // start() has been called, channels attached after that start the timer themselves
+};
@@ -3,118 +3,132 @@
       Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
       Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
       You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
-
-      With chucks taken from http://en.wikipedia.org/wiki/Circular_buffer, see licence there also
 */
 
 #ifndef RINGBUFFER_H
 #define RINGBUFFER_H
 
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed size ring buffer, thread safe for a single producer and a single consumer, eg an ISR filling it and the main loop emptying it.
+// length must be a power of two and all of it is usable, the indices run freely and are masked when the buffer is accessed.
+// Only the producer writes head and only the consumer writes tail, each is published with a release store and read with an acquire load
+// so interrupts never need to be disabled. pop_back() and flush() are the exceptions, see their notes.
+template<class kind, size_t length> class RingBuffer {
+    static_assert(length >= 2 && (length & (length - 1)) == 0, "RingBuffer length must be a power of two");
 
-template<class kind, int length> class RingBuffer {
     public:
         RingBuffer();
-        int          size();
-        int          capacity();
-        int          next_block_index(int index);
-        int          prev_block_index(int index);
-        void         push_back(kind object);
-        void         pop_front(kind &object);
-        kind*        get_head_ref();
-        kind*        get_tail_ref();
-        void         get( int index, kind &object);
-        kind*        get_ref( int index);
-        void         delete_tail();
-
-        kind         buffer[length];
-        volatile int          tail;
-        volatile int          head;
-};
 
-#include "sLPC17xx.h"
+        static constexpr size_t capacity() { return length; }
+        size_t       size() const;
+        size_t       free() const { return length - size(); }
+        bool         empty() const { return size() == 0; }
+        bool         full() const { return size() == length; }
+
+        // producer side
+        bool         push_back(const kind &object);
+        size_t       push_back(const kind *objects, size_t n);
+        bool         pop_back();
+
+        // consumer side
+        bool         pop_front(kind &object);
+        size_t       pop_front(kind *objects, size_t n);
+        kind&        peek(size_t index);
+        size_t       discard(size_t n= 1);
+        void         flush();
+
+    private:
+        static const uint32_t mask= length - 1;
+
+        kind                  buffer[length];
+        std::atomic<uint32_t> head;
+        std::atomic<uint32_t> tail;
+};
 
-template<class kind, int length> RingBuffer<kind, length>::RingBuffer(){
-    this->tail = this->head = 0;
-}
+template<class kind, size_t length> RingBuffer<kind, length>::RingBuffer() : head(0), tail(0) {}
 
-template<class kind, int length>  int RingBuffer<kind, length>::capacity(){
-    return length-1;
+// exact when called by the producer or the consumer, as one of the two indices is then its own
+template<class kind, size_t length> size_t RingBuffer<kind, length>::size() const {
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
 }
 
-template<class kind, int length>  int RingBuffer<kind, length>::size(){
-	//return((this->tail>this->head)?length:0)+this->head-tail;
-	__disable_irq();
-	int i = head - tail + ((tail > head)?length:0);
-	__enable_irq();
-	return i;
-}
+// returns false and drops the object if the buffer is full
+template<class kind, size_t length> bool RingBuffer<kind, length>::push_back(const kind &object){
+    uint32_t h= head.load(std::memory_order_relaxed);
+    if(h - tail.load(std::memory_order_acquire) >= length) return false;
 
-template<class kind, int length> int RingBuffer<kind, length>::next_block_index(int index){
-    index++;
-    if (index == length) { index = 0; }
-    return(index);
+    buffer[h & mask]= object;
+    head.store(h + 1, std::memory_order_release);
+    return true;
 }
 
-template<class kind, int length> int RingBuffer<kind, length>::prev_block_index(int index){
-    if (index == 0) { index = length; }
-    index--;
-    return(index);
-}
+// push as many of the n objects as will fit, returns how many were pushed
+template<class kind, size_t length> size_t RingBuffer<kind, length>::push_back(const kind *objects, size_t n){
+    uint32_t h= head.load(std::memory_order_relaxed);
+    size_t room= length - (h - tail.load(std::memory_order_acquire));
+    if(n > room) n= room;
 
-template<class kind, int length> void RingBuffer<kind, length>::push_back(kind object){
-    this->buffer[this->head] = object;
-    this->head = (head+1)&(length-1);
+    for (size_t i = 0; i < n; ++i) {
+        buffer[(h + i) & mask]= objects[i];
+    }
+    head.store(h + n, std::memory_order_release);
+    return n;
 }
 
-template<class kind, int length> kind* RingBuffer<kind, length>::get_head_ref(){
-    return &(buffer[head]);
+// take back the last object pushed, eg for a backspace
+// NOTE this moves head back towards tail, so it is only safe if the consumer can not be part way through a pop or discard,
+// which it can be if the producer is an ISR and the consumer is not. The consumer then has to disable interrupts around
+// its pops, as USBSerial does
+template<class kind, size_t length> bool RingBuffer<kind, length>::pop_back(){
+    uint32_t h= head.load(std::memory_order_relaxed);
+    if(h == tail.load(std::memory_order_acquire)) return false;
+    head.store(h - 1, std::memory_order_release);
+    return true;
 }
 
-template<class kind, int length> kind* RingBuffer<kind, length>::get_tail_ref(){
-    return &(buffer[tail]);
-}
+template<class kind, size_t length> bool RingBuffer<kind, length>::pop_front(kind &object){
+    uint32_t t= tail.load(std::memory_order_relaxed);
+    if(head.load(std::memory_order_acquire) == t) return false;
 
-template<class kind, int length> void RingBuffer<kind, length>::get(int index, kind &object){
-    int j= 0;
-    int k= this->tail;
-    while (k != this->head){
-        if (j == index) break;
-        j++;
-        k= (k + 1) & (length - 1);
-    }
-    // TODO : this checks wether we are asked a value out of range
-    //if (k == this->head){
-    //    return NULL;
-    //}
-    object = this->buffer[k];
+    object= buffer[t & mask];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
 }
 
+// pop up to n objects, returns how many were popped
+template<class kind, size_t length> size_t RingBuffer<kind, length>::pop_front(kind *objects, size_t n){
+    uint32_t t= tail.load(std::memory_order_relaxed);
+    size_t available= head.load(std::memory_order_acquire) - t;
+    if(n > available) n= available;
 
-template<class kind, int length> kind* RingBuffer<kind, length>::get_ref(int index){
-    int j= 0;
-    int k= this->tail;
-    while (k != this->head){
-        if (j == index) break;
-        j++;
-        k= (k + 1) & (length - 1);
-    }
-    // TODO : this checks wether we are asked a value out of range
-    if (k == this->head){
-        return 0;
+    for (size_t i = 0; i < n; ++i) {
+        objects[i]= buffer[(t + i) & mask];
     }
-    return &(this->buffer[k]);
+    tail.store(t + n, std::memory_order_release);
+    return n;
 }
 
-template<class kind, int length> void RingBuffer<kind, length>::pop_front(kind &object){
-    object = this->buffer[this->tail];
-    this->tail = (this->tail+1)&(length-1);
+// the index'th object from the front, index must be less than size()
+template<class kind, size_t length> kind& RingBuffer<kind, length>::peek(size_t index){
+    return buffer[(tail.load(std::memory_order_relaxed) + index) & mask];
 }
 
-template<class kind, int length> void RingBuffer<kind, length>::delete_tail(){
-    //kind dummy;
-    //this->pop_front(dummy);
-    this->tail = (this->tail+1)&(length-1);
+template<class kind, size_t length> size_t RingBuffer<kind, length>::discard(size_t n){
+    uint32_t t= tail.load(std::memory_order_relaxed);
+    size_t available= head.load(std::memory_order_acquire) - t;
+    if(n > available) n= available;
+    tail.store(t + n, std::memory_order_release);
+    return n;
 }
 
+// drop everything that has been pushed so far
+// NOTE this writes tail, which is fine from the consumer. From the producer it is only safe if the consumer can not be part
+// way through a pop or discard, as for pop_back()
+template<class kind, size_t length> void RingBuffer<kind, length>::flush(){
+    tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+}
 
 #endif
@@ -0,0 +1,232 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SPIQueue.h"
+#include "Pin.h"
+
+#include "cmsis.h" // mbed.h lib
+
+// SSP registers
+#define SSP_SR_TNF  (1 << 1)
+#define SSP_SR_RNE  (1 << 2)
+#define SSP_IMSC_RT (1 << 1) // receive timeout, some replies have been sitting in the FIFO for 32 bits
+#define SSP_IMSC_RX (1 << 2) // the receive FIFO is half full
+#define SSP_ICR_ALL 0x03
+#define SSP_FIFO_DEPTH 8
+
+static SPIQueue *queues[2];
+static volatile bool shared[2];
+
+SPIQueue *SPIQueue::channel(int n)
+{
+    if(n < 0 || n > 1) return nullptr;
+    if(queues[n] == nullptr) queues[n]= new SPIQueue(n);
+    return queues[n];
+}
+
+void SPIQueue::share(int n)
+{
+    if(n >= 0 && n <= 1) shared[n]= true;
+}
+
+SPIQueue::SPIQueue(int n)
+{
+    head= tail= active= nullptr;
+    number= n;
+    configured= false;
+    frequency= 0;
+    bits= mode= 0;
+
+    // same pins as everything else uses for the two channels
+    PinName mosi, miso, sclk;
+    if(n == 0) {
+        mosi= P0_18; miso= P0_17; sclk= P0_15;
+        irqn= SSP0_IRQn;
+    } else {
+        mosi= P0_9; miso= P0_8; sclk= P0_7;
+        irqn= SSP1_IRQn;
+    }
+
+    // the init sets a default format, which anything already using the channel through mbed::SPI would not know about
+    LPC_SSP_TypeDef *s= (n == 0) ? LPC_SSP0 : LPC_SSP1;
+    uint32_t cr0= s->CR0, cpsr= s->CPSR;
+    bool was_on= (s->CR1 & (1 << 1)) != 0;
+    spi_init(&spi, mosi, miso, sclk, NC);
+    ssp= spi.spi;
+    if(was_on) {
+        ssp->CR1 &= ~(1 << 1);
+        ssp->CR0= cr0;
+        ssp->CPSR= cpsr;
+        ssp->CR1 |= (1 << 1);
+    }
+
+    ssp->IMSC= 0;
+    ssp->ICR= SSP_ICR_ALL;
+    NVIC_EnableIRQ(irqn);
+}
+
+bool SPIQueue::is_shared() const
+{
+    return shared[number];
+}
+
+bool SPIQueue::submit(SPITransaction *t)
+{
+    // this can be called from the main loop and from interrupts so keep them out while the list is changed
+    uint32_t primask= __get_PRIMASK();
+    __disable_irq();
+    if(t->is_pending()) {
+        if(primask == 0) __enable_irq();
+        return false;
+    }
+
+    t->state= SPITransaction::QUEUED;
+    t->next= nullptr;
+    if(tail == nullptr) head= t; else tail->next= t;
+    tail= t;
+    if(!is_shared() && active == nullptr) start_next();
+    if(primask == 0) __enable_irq();
+    return true;
+}
+
+bool SPIQueue::transfer(SPITransaction *t)
+{
+    if(!submit(t)) return false;
+    if(is_shared()) {
+        run_queued();
+    } else {
+        while(t->is_pending()) ;
+    }
+    return true;
+}
+
+void SPIQueue::poll()
+{
+    if(is_shared() && head != nullptr) run_queued();
+}
+
+// only when the settings change, working out the clock divider takes a while
+void SPIQueue::configure(const SPITransaction *t)
+{
+    if(configured && t->bits == bits && t->mode == mode && t->frequency == frequency) return;
+    spi_format(&spi, t->bits, t->mode, 0);
+    spi_frequency(&spi, t->frequency);
+    bits= t->bits;
+    mode= t->mode;
+    frequency= t->frequency;
+    configured= true;
+}
+
+// with interrupts off or from the interrupt
+void SPIQueue::start_next()
+{
+    SPITransaction *t= head;
+    if(t == nullptr) {
+        ssp->IMSC= 0;
+        return;
+    }
+    head= t->next;
+    if(head == nullptr) tail= nullptr;
+
+    configure(t);
+    t->sent= t->received= 0;
+    t->state= SPITransaction::ACTIVE;
+    active= t;
+
+    // the first clock edge is half a bit after the first frame goes in, which covers the chip select setup time of the
+    // devices we have
+    if(t->cs != nullptr) t->cs->set(false);
+    service();
+    if(!is_shared()) ssp->IMSC= SSP_IMSC_RT | SSP_IMSC_RX;
+}
+
+// collect the replies and top the FIFO back up, returns true once the last reply is in
+bool SPIQueue::service()
+{
+    SPITransaction *t= active;
+
+    while(ssp->SR & SSP_SR_RNE) {
+        uint16_t v= ssp->DR;
+        if(t->received < t->n) {
+            if(t->rx != nullptr) {
+                if(t->bits > 8) static_cast<uint16_t*>(t->rx)[t->received]= v;
+                else static_cast<uint8_t*>(t->rx)[t->received]= v;
+            }
+            ++t->received;
+        }
+    }
+
+    // never more in flight than the receive FIFO can hold
+    while(t->sent < t->n && t->sent - t->received < SSP_FIFO_DEPTH && (ssp->SR & SSP_SR_TNF)) {
+        uint16_t v= 0;
+        if(t->tx != nullptr) {
+            v= (t->bits > 8) ? static_cast<const uint16_t*>(t->tx)[t->sent] : static_cast<const uint8_t*>(t->tx)[t->sent];
+        }
+        ssp->DR= v;
+        ++t->sent;
+    }
+
+    return t->received >= t->n;
+}
+
+void SPIQueue::finish()
+{
+    SPITransaction *t= active;
+    if(t->cs != nullptr) t->cs->set(true);
+    active= nullptr;
+    t->state= SPITransaction::DONE;
+}
+
+void SPIQueue::irq()
+{
+    ssp->ICR= SSP_ICR_ALL;
+    if(active == nullptr) {
+        ssp->IMSC= 0;
+        return;
+    }
+    if(service()) {
+        finish();
+        start_next();
+    }
+}
+
+// run everything queued now, leaving the SSP as it was found for whoever else uses the channel
+void SPIQueue::run_queued()
+{
+    uint32_t cr0= ssp->CR0, cpsr= ssp->CPSR;
+
+    while(true) {
+        __disable_irq();
+        if(head == nullptr) {
+            __enable_irq();
+            break;
+        }
+        start_next();
+        __enable_irq();
+
+        while(!service()) ;
+        finish();
+    }
+
+    if(configured) {
+        ssp->CR1 &= ~(1 << 1);
+        ssp->CR0= cr0;
+        ssp->CPSR= cpsr;
+        ssp->CR1 |= (1 << 1);
+        configured= false;
+    }
+}
+
+extern "C" void SSP0_IRQHandler(void)
+{
+    if(queues[0] != nullptr) queues[0]->irq();
+}
+
+extern "C" void SSP1_IRQHandler(void)
+{
+    if(queues[1] != nullptr) queues[1]->irq();
+}
@@ -0,0 +1,94 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPIQUEUE_H
+#define SPIQUEUE_H
+
+#include "spi_api.h" // mbed.h lib
+
+#include <stdint.h>
+
+class Pin;
+
+// One exchange with a device, the chip select is held low for all of it.
+// The caller owns it and its buffers, which must stay put until it is no longer pending.
+class SPITransaction {
+    public:
+        SPITransaction() : cs(nullptr), tx(nullptr), rx(nullptr), n(0), bits(8), mode(0), frequency(1000000), state(IDLE), next(nullptr) {}
+
+        bool is_pending() const { return state == QUEUED || state == ACTIVE; }
+        bool is_done() const { return state == DONE; }
+
+        // frames are uint8_t for up to 8 bits and uint16_t above that, a null tx sends zeros and a null rx throws the replies away
+        Pin *cs;
+        const void *tx;
+        void *rx;
+        uint16_t n;
+        uint8_t bits;
+        uint8_t mode;
+        uint32_t frequency;
+
+    private:
+        friend class SPIQueue;
+        enum STATE { IDLE, QUEUED, ACTIVE, DONE };
+
+        volatile uint8_t state;
+        uint16_t sent, received;
+        SPITransaction *next;
+};
+
+// Queues transactions on one of the SSP channels and runs them from the SSP interrupt, so a device can be read without
+// the main loop or a ticker waiting for the bits to go out. The FIFO is kept topped up so the interrupt only comes
+// when there are replies to collect, and the next transaction is started as soon as one finishes.
+//
+// Devices that drive a channel through mbed::SPI themselves, like the sdcard and the panels, do not go through the queue
+// and would be corrupted by a transaction starting under them, so they mark their channel as shared. On a shared channel
+// transactions are only run from poll() in the main loop, which is where those devices run too, and the SSP settings are
+// put back afterwards.
+class SPIQueue {
+    public:
+        // the queue for SSP0 or SSP1, made on first use
+        static SPIQueue *channel(int n);
+        // there is a device on channel n that does not use the queue
+        static void share(int n);
+
+        // queue a transaction, returns false if it is still pending. may be called from an interrupt
+        bool submit(SPITransaction *t);
+        // submit and wait for it to finish, from the main loop only
+        bool transfer(SPITransaction *t);
+        // runs the queued transactions on a shared channel, does nothing otherwise
+        void poll();
+
+        void irq();
+
+    private:
+        SPIQueue(int n);
+
+        bool is_shared() const;
+        void configure(const SPITransaction *t);
+        void start_next();
+        bool service();
+        void finish();
+        void run_queued();
+
+        spi_t spi;
+        LPC_SSP_TypeDef *ssp;
+        IRQn_Type irqn;
+
+        SPITransaction *head;
+        SPITransaction *tail;
+        SPITransaction * volatile active;
+
+        // what the SSP is set up for now
+        uint32_t frequency;
+        uint8_t bits;
+        uint8_t mode;
+        uint8_t number;
+        bool configured;
+};
+
+#endif
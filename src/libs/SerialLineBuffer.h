@@ -0,0 +1,65 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SERIALLINEBUFFER_H
+#define SERIALLINEBUFFER_H
+
+#include "RingBuffer.h"
+
+#include <string>
+
+// Collects the chars from a receive interrupt into lines for the main loop.
+// A line that does not fit is dropped whole. The rest of it is thrown away as it arrives, and nothing more is queued until
+// the main loop has thrown away the part that was queued. So a full buffer can not leave the main loop waiting for a
+// newline that was never queued, and the start of one line is never joined to the end of another.
+// Only the interrupt pushes and only the main loop pops, as the RingBuffer needs.
+template<size_t length> class SerialLineBuffer {
+    public:
+        SerialLineBuffer() : lost_line(false), discard_to_nl(false) {}
+
+        // from the receive interrupt
+        void receive(char c)
+        {
+            if(!lost_line && !discard_to_nl) {
+                if(buffer.push_back(c)) return;
+                lost_line= true;
+            }
+            discard_to_nl= (c != '\n');
+        }
+
+        // from the main loop, gets the next whole line without its newline
+        bool get_line(std::string& line)
+        {
+            // read first, once it is set nothing more is pushed so what is queued now is all there is
+            bool lost= lost_line;
+
+            size_t n= buffer.size();
+            for (size_t i = 0; i < n; ++i) {
+                if(buffer.peek(i) == '\n') {
+                    line.clear();
+                    line.reserve(i);
+                    for (size_t j = 0; j < i; ++j) line += buffer.peek(j);
+                    buffer.discard(i + 1);
+                    return true;
+                }
+            }
+
+            if(lost) {
+                // no whole lines left, so this is the start of the line that did not fit
+                buffer.discard(n);
+                lost_line= false;
+            }
+            return false;
+        }
+
+    private:
+        RingBuffer<char, length> buffer;
+        volatile bool lost_line;        // a line did not fit, set by the interrupt and cleared by the main loop
+        volatile bool discard_to_nl;    // only used by the interrupt
+};
+
+#endif
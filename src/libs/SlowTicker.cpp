@@ -13,14 +13,36 @@
 #include "libs/Hook.h"
 #include "modules/robot/Conveyor.h"
 #include "Gcode.h"
+#include "StreamOutput.h"
+
+#include "CycleCounter.h"
 
 #include <mri.h>
+#include <algorithm>
+#include "mbed.h" // for us_ticker_read()
 
 // This module uses a Timer to periodically call hooks
 // Modules register with a function ( callback ) and a frequency, and we then call that function at the given frequency.
+// The timer free runs and the match register is set to the earliest deadline, so the interrupt only happens when a hook is due
+// rather than at the highest frequency any hook asked for.
+
+// if the next deadline is closer than this many timer counts (1us, TIMER2 runs at SystemCoreClock/4 = 25MHz) it is treated as already due so the match cannot be missed
+#define MIN_MATCH_COUNTS 25
 
 SlowTicker* global_slow_ticker;
 
+// true if deadline a is before b, the timer wraps every 171 seconds so this only works for deadlines less than half that apart
+static inline bool before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+// ordering for std heap functions to make a min heap on deadline
+static bool later(const Hook *a, const Hook *b)
+{
+    return before(b->deadline, a->deadline);
+}
+
 SlowTicker::SlowTicker(){
     global_slow_ticker = this;
 
@@ -28,13 +50,15 @@ SlowTicker::SlowTicker(){
     ispbtn.from_string("2.10")->as_input()->pull_up();
 
     LPC_SC->PCONP |= (1 << 22);     // Power Ticker ON
-    LPC_TIM2->MCR = 3;              // Match on MR0, reset on MR0
+    LPC_TIM2->MCR = 1;              // Interrupt on MR0, the timer free runs
     // do not enable interrupt until setup is complete
-    LPC_TIM2->TCR = 0;              // Disable interrupt
+    LPC_TIM2->TCR = 2;              // Reset and hold, so deadlines of hooks attached before start are relative to 0
+    LPC_TIM2->PR = 0;
 
-    max_frequency = 5;  // initial max frequency is set to 5Hz
-    set_frequency(max_frequency);
+    next_second = SystemCoreClock >> 2;  // SystemCoreClock/4 = Timer increments in a second
+    LPC_TIM2->MR0 = next_second;
     flag_1s_flag = 0;
+    clear_stats();
 }
 
 void SlowTicker::start()
@@ -47,37 +71,82 @@ void SlowTicker::on_module_loaded(){
     register_for_event(ON_IDLE);
 }
 
-// Set the base frequency we use for all sub-frequencies
-void SlowTicker::set_frequency( int frequency ){
-    this->interval = (SystemCoreClock >> 2) / frequency;   // SystemCoreClock/4 = Timer increments in a second
-    LPC_TIM2->MR0 = this->interval;
-    LPC_TIM2->TCR = 3;  // Reset
-    LPC_TIM2->TCR = 1;  // Reset
-    flag_1s_count= SystemCoreClock>>2;
+void SlowTicker::add_hook(Hook *hook, uint32_t frequency)
+{
+    // a hook asking for 0Hz, which Laser can do for very long pwm periods, gets the slowest rate instead of a divide by zero
+    if(frequency == 0) frequency = 1;
+    hook->interval = floorf((SystemCoreClock/4)/frequency);
+
+    // to avoid race conditions we must stop the interupts before updating this non thread safe vector
+    __disable_irq();
+    hook->deadline = LPC_TIM2->TC + hook->interval;
+    this->hooks.push_back(hook);
+    std::push_heap(this->hooks.begin(), this->hooks.end(), later);
+    set_next_match();
+    __enable_irq();
+}
+
+Hook* SlowTicker::attach( uint32_t frequency, std::function<void(void)> fnc )
+{
+    Hook* hook = new Hook();
+    hook->function = fnc;
+    add_hook(hook, frequency);
+    return hook;
+}
+
+// stop calling the hook and delete it
+void SlowTicker::detach( Hook *hook )
+{
+    __disable_irq();
+    auto i = std::find(this->hooks.begin(), this->hooks.end(), hook);
+    if(i != this->hooks.end()) {
+        this->hooks.erase(i);
+        std::make_heap(this->hooks.begin(), this->hooks.end(), later);
+    }
+    __enable_irq();
+    delete hook;
+}
+
+// set the match for the earliest of the next hook and the second flag, must be called with interrupts off
+void SlowTicker::set_next_match()
+{
+    uint32_t next = next_second;
+    if(!this->hooks.empty() && before(this->hooks.front()->deadline, next)) {
+        next = this->hooks.front()->deadline;
+    }
+    LPC_TIM2->MR0 = next;
 }
 
 // The actual interrupt being called by the timer, this is where work is done
 void SlowTicker::tick(){
+    // the cycle counter is enabled at boot by the BootProfiler
+    uint32_t start_cycles = read_cycle_counter();
+
+    while(true) {
+        uint32_t now = LPC_TIM2->TC;
+
+        // Call the hooks that are due, rescheduling each one before it is called
+        while (!this->hooks.empty() && !before(now, this->hooks.front()->deadline)) {
+            std::pop_heap(this->hooks.begin(), this->hooks.end(), later);
+            Hook *hook = this->hooks.back();
+            hook->deadline += hook->interval;
+            // if we fell a long way behind (eg in the debugger) do not try to catch up
+            if(before(hook->deadline, now)) hook->deadline = now + hook->interval;
+            std::push_heap(this->hooks.begin(), this->hooks.end(), later);
+            hook->call_hook();
+        }
 
-    // Call all hooks that need to be called
-    for (Hook* hook : this->hooks){
-        hook->countdown -= this->interval;
-        if (hook->countdown < 0)
-        {
-            hook->countdown += hook->interval;
-            hook->call();
+        // if a whole second has elapsed,
+        if (!before(now, next_second)) {
+            // add a second to our counter
+            next_second += SystemCoreClock >> 2;
+            // and set a flag for idle event to pick up
+            flag_1s_flag++;
         }
-    }
 
-    // deduct tick time from second counter
-    flag_1s_count -= this->interval;
-    // if a whole second has elapsed,
-    if (flag_1s_count < 0)
-    {
-        // add a second to our counter
-        flag_1s_count += SystemCoreClock >> 2;
-        // and set a flag for idle event to pick up
-        flag_1s_flag++;
+        set_next_match();
+        // if the next deadline is already here or too close we may have missed the match, so go round again
+        if(before(LPC_TIM2->TC + MIN_MATCH_COUNTS, LPC_TIM2->MR0)) break;
     }
 
     // Enter MRI mode if the ISP button is pressed
@@ -85,6 +154,26 @@ void SlowTicker::tick(){
     if (ispbtn.get() == 0)
         __debugbreak();
 
+    uint32_t cycles = read_cycle_counter() - start_cycles;
+    isr_count++;
+    isr_cycles += cycles;
+    if(cycles > isr_max_cycles) isr_max_cycles = cycles;
+}
+
+void SlowTicker::clear_stats()
+{
+    isr_count = 0;
+    isr_cycles = 0;
+    isr_max_cycles = 0;
+    stats_start = us_ticker_read();
+}
+
+void SlowTicker::dump_stats(StreamOutput *stream) const
+{
+    uint32_t mhz = SystemCoreClock / 1000000;
+    uint32_t elapsed = us_ticker_read() - stats_start;
+    stream->printf("SlowTicker: %u hooks, %lu interrupts in %lu ms, %lu us total, avg %lu us, max %lu us\n",
+                   this->hooks.size(), isr_count, elapsed / 1000, (uint32_t)(isr_cycles / mhz), isr_count > 0 ? (uint32_t)(isr_cycles / mhz / isr_count) : 0, isr_max_cycles / mhz);
 }
 
 bool SlowTicker::flag_1s(){
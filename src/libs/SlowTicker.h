@@ -16,6 +16,10 @@
 
 #include "system_LPC17xx.h" // for SystemCoreClock
 #include <math.h>
+#include <vector>
+#include <functional>
+
+class StreamOutput;
 
 class SlowTicker : public Module{
     public:
@@ -24,37 +28,37 @@ class SlowTicker : public Module{
         void on_module_loaded(void);
         void on_idle(void*);
         void start();
-        void set_frequency( int frequency );
         void tick();
         // For some reason this can't go in the .cpp, see :  http://mbed.org/forum/mbed/topic/2774/?page=1#comment-14221
-        // TODO replace this with std::function()
         template<typename T> Hook* attach( uint32_t frequency, T *optr, uint32_t ( T::*fptr )( uint32_t ) ){
             Hook* hook = new Hook();
-            hook->interval = floorf((SystemCoreClock/4)/frequency);
             hook->attach(optr, fptr);
-            hook->countdown = hook->interval;
-
-            // to avoid race conditions we must stop the interupts before updating this non thread safe vector
-            __disable_irq();
-            if( frequency > this->max_frequency ){
-                this->max_frequency = frequency;
-                this->set_frequency(frequency);
-            }
-            this->hooks.push_back(hook);
-            __enable_irq();
+            add_hook(hook, frequency);
             return hook;
         }
+        Hook* attach( uint32_t frequency, std::function<void(void)> fnc );
+        void detach( Hook *hook );
+
+        void dump_stats(StreamOutput *stream) const;
+        void clear_stats();
 
     private:
         bool flag_1s();
+        void add_hook(Hook *hook, uint32_t frequency);
+        void set_next_match();
 
+        // min heap of hooks ordered by deadline, so a tick only looks at the hooks that are due
         std::vector<Hook*> hooks;
-        uint32_t max_frequency;
-        uint32_t interval;
+        uint32_t next_second;
+
+        // ISR statistics
+        uint32_t isr_count;
+        uint64_t isr_cycles;
+        uint32_t isr_max_cycles;
+        uint32_t stats_start;
 
         Pin ispbtn;
 protected:
-    int flag_1s_count;
     volatile int flag_1s_flag;
 };
 
@@ -0,0 +1,82 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SORTEDWINDOW_H
+#define SORTEDWINDOW_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The last length samples kept both in arrival order and in sorted order, so the median and a trimmed mean
+// are available at any time without sorting.
+// put() replaces the oldest sample and moves the new one into place, only the samples lying between the old and
+// the new value are shifted, so for a slowly changing signal like a thermistor this is nearly constant time.
+// The window starts out full of zeros.
+template<size_t length> class SortedWindow {
+    static_assert(length >= 4 && (length & (length - 1)) == 0, "SortedWindow length must be a power of two");
+
+    public:
+        SortedWindow() { clear(); }
+
+        void clear()
+        {
+            for (size_t i = 0; i < length; ++i) {
+                ring[i]= 0;
+                sorted[i]= 0;
+            }
+            pos= 0;
+        }
+
+        void put(uint16_t value)
+        {
+            uint16_t old= ring[pos];
+            ring[pos]= value;
+            pos= (pos + 1) & (length - 1);
+
+            // find the old sample, any copy of it will do
+            size_t lo= 0, hi= length - 1;
+            while(lo < hi) {
+                size_t mid= (lo + hi) / 2;
+                if(sorted[mid] < old) lo= mid + 1; else hi= mid;
+            }
+
+            // slide the neighbours over the old one until the new one fits
+            size_t i= lo;
+            if(value > old) {
+                while(i < length - 1 && sorted[i + 1] < value) {
+                    sorted[i]= sorted[i + 1];
+                    ++i;
+                }
+            } else {
+                while(i > 0 && sorted[i - 1] > value) {
+                    sorted[i]= sorted[i - 1];
+                    --i;
+                }
+            }
+            sorted[i]= value;
+        }
+
+        uint16_t median() const { return sorted[length / 2]; }
+        uint16_t operator[](size_t i) const { return sorted[i]; }
+
+        // sum of the middle half of the samples, the top and bottom quarter are treated as spikes
+        uint32_t trimmed_sum() const
+        {
+            uint32_t sum= 0;
+            for (size_t i = length / 4; i < length - length / 4; ++i) {
+                sum += sorted[i];
+            }
+            return sum;
+        }
+
+    private:
+        uint16_t ring[length];
+        uint16_t sorted[length];
+        uint16_t pos;
+};
+
+#endif
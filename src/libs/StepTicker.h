@@ -16,7 +16,6 @@
 #include <atomic>
 
 #include "ActuatorCoordinates.h"
-#include "TSRingBuffer.h"
 
 class StepperMotor;
 class Block;
@@ -26,13 +26,14 @@
 #include "StreamOutputPool.h"
 
 #include "mbed.h"
+#include "cmsis.h"
 
 // extern void setled(int, bool);
 #define setled(a, b) do {} while (0)
 
 #define iprintf(...) do { } while (0)
 
-USBSerial::USBSerial(USB *u): USBCDC(u), rxbuf(256 + 8), txbuf(128 + 8)
+USBSerial::USBSerial(USB *u): USBCDC(u)
 {
     usb = u;
     nl_in_rx = 0;
@@ -47,7 +48,7 @@ bool USBSerial::ensure_tx_space(int space)
 {
     // we need some kind of timeout here or it will hang if upstream stalls
     uint32_t start = us_ticker_read();
-    while (txbuf.free() < space) {
+    while ((int)txbuf.free() < space) {
         if((us_ticker_read() - start) > 1000000) {
             // 1 second timeout
             return false;
@@ -63,7 +64,7 @@ int USBSerial::_putc(int c)
     if (!attached)
         return 1;
     if(ensure_tx_space(1)) {
-        txbuf.queue(c);
+        txbuf.push_back(c);
     }
 
     usb->endpointSetInterrupt(CDC_BulkIn.bEndpointAddress, true);
@@ -75,22 +76,34 @@ int USBSerial::_getc()
     if (!attached)
         return 0;
     uint8_t c = 0;
-    setled(4, 1); while (rxbuf.isEmpty()); setled(4, 0);
-    rxbuf.dequeue(&c);
+    setled(4, 1);
+    while (true) {
+        while (rxbuf.empty()) ;
+        // the endpoint ISR flushes and pops back rxbuf, which move the end we pop from, so keep it out until we are done
+        __disable_irq();
+        if (rxbuf.pop_front(c)) break;
+        // it was flushed after we saw it was not empty
+        __enable_irq();
+    }
+    setled(4, 0);
+    bool room = false;
     if (rxbuf.free() == MAX_PACKET_SIZE_EPBULK) {
-        usb->endpointSetInterrupt(CDC_BulkOut.bEndpointAddress, true);
-        iprintf("rxbuf has room for another packet, interrupt enabled\n");
+        room = true;
     } else if ((rxbuf.free() < MAX_PACKET_SIZE_EPBULK) && (nl_in_rx == 0)) {
         // handle potential deadlock where a short line, and the beginning of a very long line are bundled in one usb packet
         rxbuf.flush();
         flush_to_nl = true;
-
-        usb->endpointSetInterrupt(CDC_BulkOut.bEndpointAddress, true);
-        iprintf("rxbuf has room for another packet, interrupt enabled\n");
+        room = true;
     }
     if (nl_in_rx > 0)
         if (c == '\n' || c == '\r')
             nl_in_rx--;
+    __enable_irq();
+
+    if (room) {
+        usb->endpointSetInterrupt(CDC_BulkOut.bEndpointAddress, true);
+        iprintf("rxbuf has room for another packet, interrupt enabled\n");
+    }
 
     return c;
 }
@@ -102,8 +115,8 @@ int USBSerial::puts(const char *str)
     int i = 0;
     while (*str) {
         if(!ensure_tx_space(1)) break;
-        txbuf.queue(*str);
-        if ((txbuf.available() % 64) == 0)
+        txbuf.push_back(*str);
+        if ((txbuf.size() % 64) == 0)
             usb->endpointSetInterrupt(CDC_BulkIn.bEndpointAddress, true);
         i++;
         str++;
@@ -116,13 +129,8 @@ uint16_t USBSerial::writeBlock(const uint8_t * buf, uint16_t size)
 {
     if (!attached)
         return size;
-    if (size > txbuf.free()) {
-        size = txbuf.free();
-    }
+    size = txbuf.push_back(buf, size);
     if (size > 0) {
-        for (uint8_t i = 0; i < size; i++) {
-            txbuf.queue(buf[i]);
-        }
         usb->endpointSetInterrupt(CDC_BulkIn.bEndpointAddress, true);
     }
     return size;
@@ -145,19 +153,13 @@ bool USBSerial::USBEvent_EPIn(uint8_t bEP, uint8_t bEPStatus)
 
     uint8_t b[MAX_PACKET_SIZE_EPBULK];
 
-    int l = txbuf.available();
+    // Use MAX_PACKET_SIZE_EPBULK-1 below instead of MAX_PACKET_SIZE_EPBULK
+    // to work around a problem sending packets that are exactly MAX_PACKET_SIZE_EPBULK
+    // bytes in length. The problem is that these packets don't flush properly.
+    int l = txbuf.pop_front(b, MAX_PACKET_SIZE_EPBULK-1);
     if (l > 0) {
-        // Use MAX_PACKET_SIZE_EPBULK-1 below instead of MAX_PACKET_SIZE_EPBULK
-        // to work around a problem sending packets that are exactly MAX_PACKET_SIZE_EPBULK
-        // bytes in length. The problem is that these packets don't flush properly.
-        if (l > MAX_PACKET_SIZE_EPBULK-1)
-            l = MAX_PACKET_SIZE_EPBULK-1;
-        int i;
-        for (i = 0; i < l; i++) {
-            txbuf.dequeue(&b[i]);
-        }
         send(b, l);
-        if (txbuf.available() == 0)
+        if (txbuf.size() == 0)
             r = false;
     } else {
         r = false;
@@ -193,7 +195,7 @@ bool USBSerial::USBEvent_EPOut(uint8_t bEP, uint8_t bEPStatus)
 
         // handle backspace and delete by deleting the last character in the buffer if there is one
         if(c[i] == 0x08 || c[i] == 0x7F) {
-            if(!rxbuf.isEmpty()) rxbuf.pop();
+            if(!rxbuf.empty()) rxbuf.pop_back();
             continue;
         }
 
@@ -223,7 +225,7 @@ bool USBSerial::USBEvent_EPOut(uint8_t bEP, uint8_t bEPStatus)
         last_char_was_dollar = (c[i] == '$');
 
         if (flush_to_nl == false)
-            rxbuf.queue(c[i]);
+            rxbuf.push_back(c[i]);
 
         // if (c[i] >= 32 && c[i] < 128)
         // {
@@ -239,7 +241,7 @@ bool USBSerial::USBEvent_EPOut(uint8_t bEP, uint8_t bEPStatus)
                 flush_to_nl = false;
             else
                 nl_in_rx++;
-        } else if (rxbuf.isFull() && (nl_in_rx == 0)) {
+        } else if (rxbuf.full() && (nl_in_rx == 0)) {
             // to avoid a deadlock with very long lines, we must dump the buffer
             // and continue flushing to the next newline
             rxbuf.flush();
@@ -267,14 +269,14 @@ bool USBSerial::USBEvent_EPOut(uint8_t bEP, uint8_t bEPStatus)
     return r;
 }
 
-uint8_t USBSerial::available()
+uint16_t USBSerial::available()
 {
-    return rxbuf.available();
+    return rxbuf.size();
 }
 
 bool USBSerial::ready()
 {
-    return rxbuf.available();
+    return rxbuf.size();
 }
 
 void USBSerial::on_module_loaded()
@@ -293,8 +295,10 @@ void USBSerial::on_idle(void *argument)
         } else {
             puts("HALTED, M999 or $X to exit HALT state\r\n");
         }
+        __disable_irq();
         rxbuf.flush(); // flush the recieve buffer, hopefully upstream has stopped sending
         nl_in_rx = 0;
+        __enable_irq();
     }
 
     if(query_flag) {
@@ -322,8 +326,10 @@ void USBSerial::on_main_loop(void *argument)
             attached = false;
             THEKERNEL->streams->remove_stream(this);
             txbuf.flush();
+            __disable_irq();
             rxbuf.flush();
             nl_in_rx = 0;
+            __enable_irq();
         }
     }
 
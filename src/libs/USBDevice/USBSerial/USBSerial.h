@@ -21,7 +21,7 @@
 
 #include "USBCDC.h"
 // #include "Stream.h"
-#include "CircBuffer.h"
+#include "RingBuffer.h"
 
 #include "Module.h"
 #include "StreamOutput.h"
@@ -39,13 +39,13 @@ public:
     int _getc();
     int puts(const char *);
 
-    uint8_t available();
+    uint16_t available();
     bool ready();
 
     uint16_t writeBlock(const uint8_t * buf, uint16_t size);
 
-    CircBuffer<uint8_t> rxbuf;
-    CircBuffer<uint8_t> txbuf;
+    RingBuffer<uint8_t, 256> rxbuf;
+    RingBuffer<uint8_t, 128> txbuf;
 
     void on_module_loaded(void);
     void on_main_loop(void *);
@@ -36,6 +36,7 @@
 #include "ConfigValue.h"
 #include "StepTicker.h"
 #include "SlowTicker.h"
+#include "PwmEngine.h"
 #include "Robot.h"
 
 // #include "libs/ChaNFSSD/SDFileSystem.h"
@@ -51,10 +52,13 @@
 #include "libs/USBDevice/USBSerial/USBSerial.h"
 #include "libs/USBDevice/DFU.h"
 #include "libs/SDFAT.h"
+#include "libs/SPIQueue.h"
 #include "StreamOutputPool.h"
 #include "ToolManager.h"
 
 #include "libs/Watchdog.h"
+#include "libs/BootProfiler.h"
+#include "libs/CycleCounter.h"
 
 #include "version.h"
 #include "system_LPC17xx.h"
@@ -66,6 +70,7 @@
 #define disable_msd_checksum  CHECKSUM("msd_disable")
 #define dfu_enable_checksum  CHECKSUM("dfu_enable")
 #define watchdog_timeout_checksum  CHECKSUM("watchdog_timeout")
+#define boot_profile_checksum  CHECKSUM("boot_profile")
 
 
 // USB Stuff
@@ -99,12 +104,23 @@ void init() {
         leds[i]= 0;
     }
 
+    // the profilers and the SlowTicker ISR stats all time with it
+    enable_cycle_counter();
+
+    BootProfiler::init();
+    int p= BootProfiler::begin("kernel");
     Kernel* kernel = new Kernel();
+    BootProfiler::end(p);
 
     kernel->streams->printf("Smoothie Running @%ldMHz\r\n", SystemCoreClock / 1000000);
     SimpleShell::version_command("", kernel->streams);
 
+    // the sdcard drives its channel itself, keep queued transfers on it to the main loop
+    SPIQueue::share(1);
+
+    p= BootProfiler::begin("sd init");
     bool sdok= (sd.disk_initialize() == 0);
+    BootProfiler::end(p);
     if(!sdok) kernel->streams->printf("SDCard failed to initialize\r\n");
 
     #ifdef NONETWORK
@@ -126,113 +142,129 @@ void init() {
 #endif
 
     // Create and add main modules
-    kernel->add_module( new(AHB0) Player() );
+    kernel->add_module( new(AHB0) Player(), "Player" );
 
-    kernel->add_module( new(AHB0) CurrentControl() );
-    kernel->add_module( new(AHB0) KillButton() );
-    kernel->add_module( new(AHB0) PlayLed() );
+    kernel->add_module( new(AHB0) CurrentControl(), "CurrentControl" );
+    kernel->add_module( new(AHB0) KillButton(), "KillButton" );
+    kernel->add_module( new(AHB0) PlayLed(), "PlayLed" );
 
     // these modules can be completely disabled in the Makefile by adding to EXCLUDE_MODULES
     #ifndef NO_TOOLS_SWITCH
+    p= BootProfiler::begin("SwitchPool");
     SwitchPool *sp= new SwitchPool();
     sp->load_tools();
     delete sp;
+    BootProfiler::end(p);
     #endif
     #ifndef NO_TOOLS_EXTRUDER
     // NOTE this must be done first before Temperature control so ToolManager can handle Tn before temperaturecontrol module does
+    p= BootProfiler::begin("ExtruderMaker");
     ExtruderMaker *em= new ExtruderMaker();
     em->load_tools();
     delete em;
+    BootProfiler::end(p);
     #endif
     #ifndef NO_TOOLS_TEMPERATURECONTROL
     // Note order is important here must be after extruder so Tn as a parameter will get executed first
+    p= BootProfiler::begin("TemperatureControlPool");
     TemperatureControlPool *tp= new TemperatureControlPool();
     tp->load_tools();
     delete tp;
+    BootProfiler::end(p);
     #endif
     #ifndef NO_TOOLS_ENDSTOPS
-    kernel->add_module( new(AHB0) Endstops() );
+    kernel->add_module( new(AHB0) Endstops(), "Endstops" );
     #endif
     #ifndef NO_TOOLS_LASER
-    kernel->add_module( new Laser() );
+    kernel->add_module( new Laser(), "Laser" );
     #endif
     #ifndef NO_TOOLS_SPINDLE
+    p= BootProfiler::begin("SpindleMaker");
     SpindleMaker *sm= new SpindleMaker();
     sm->load_spindle();
     delete sm;
+    BootProfiler::end(p);
     //kernel->add_module( new(AHB0) Spindle() );
     #endif
     #ifndef NO_UTILS_PANEL
-    kernel->add_module( new(AHB0) Panel() );
+    kernel->add_module( new(AHB0) Panel(), "Panel" );
     #endif
     #ifndef NO_TOOLS_ZPROBE
-    kernel->add_module( new(AHB0) ZProbe() );
+    kernel->add_module( new(AHB0) ZProbe(), "ZProbe" );
     #endif
     #ifndef NO_TOOLS_SCARACAL
-    kernel->add_module( new(AHB0) SCARAcal() );
+    kernel->add_module( new(AHB0) SCARAcal(), "SCARAcal" );
     #endif
     #ifndef NO_TOOLS_ROTARYDELTACALIBRATION
-    kernel->add_module( new(AHB0) RotaryDeltaCalibration() );
+    kernel->add_module( new(AHB0) RotaryDeltaCalibration(), "RotaryDeltaCalibration" );
     #endif
     #ifndef NONETWORK
-    kernel->add_module( new Network() );
+    kernel->add_module( new Network(), "Network" );
     #endif
     #ifndef NO_TOOLS_TEMPERATURESWITCH
     // Must be loaded after TemperatureControl
-    kernel->add_module( new(AHB0) TemperatureSwitch() );
+    kernel->add_module( new(AHB0) TemperatureSwitch(), "TemperatureSwitch" );
     #endif
     #ifndef NO_TOOLS_DRILLINGCYCLES
-    kernel->add_module( new(AHB0) Drillingcycles() );
+    kernel->add_module( new(AHB0) Drillingcycles(), "Drillingcycles" );
     #endif
     #ifndef NO_TOOLS_FILAMENTDETECTOR
-    kernel->add_module( new(AHB0) FilamentDetector() );
+    kernel->add_module( new(AHB0) FilamentDetector(), "FilamentDetector" );
     #endif
     #ifndef NO_TOOLS_SWITCHWATCHDOG
+    p= BootProfiler::begin("SwitchWatchdogPool");
     SwitchWatchdogPool *swp= new SwitchWatchdogPool();
     swp->load_tools();
     delete swp;
+    BootProfiler::end(p);
     #endif
     #ifndef NO_UTILS_MOTORDRIVERCONTROL
-    kernel->add_module( new MotorDriverControl(0) );
+    kernel->add_module( new MotorDriverControl(0), "MotorDriverControl" );
     #endif
     // Create and initialize USB stuff
+    p= BootProfiler::begin("usb init");
     u.init();
+    BootProfiler::end(p);
 
 #ifdef DISABLEMSD
     if(sdok && msc != NULL){
-        kernel->add_module( msc );
+        kernel->add_module( msc, "USBMSD" );
     }
 #else
-    kernel->add_module( &msc );
+    kernel->add_module( &msc, "USBMSD" );
 #endif
 
-    kernel->add_module( &usbserial );
+    kernel->add_module( &usbserial, "USBSerial" );
     if( kernel->config->value( second_usb_serial_enable_checksum )->by_default(false)->as_bool() ){
-        kernel->add_module( new(AHB0) USBSerial(&u) );
+        kernel->add_module( new(AHB0) USBSerial(&u), "USBSerial" );
     }
 
     if( kernel->config->value( dfu_enable_checksum )->by_default(false)->as_bool() ){
-        kernel->add_module( new(AHB0) DFU(&u));
+        kernel->add_module( new(AHB0) DFU(&u), "DFU" );
     }
 
     // 10 second watchdog timeout (or config as seconds)
     float t= kernel->config->value( watchdog_timeout_checksum )->by_default(10.0F)->as_number();
     if(t > 0.1F) {
         // NOTE setting WDT_RESET with the current bootloader would leave it in DFU mode which would be suboptimal
-        kernel->add_module( new Watchdog(t*1000000, WDT_MRI)); // WDT_RESET));
+        kernel->add_module( new Watchdog(t*1000000, WDT_MRI), "Watchdog" ); // WDT_RESET));
         kernel->streams->printf("Watchdog enabled for %f seconds\n", t);
     }else{
         kernel->streams->printf("WARNING Watchdog is disabled\n");
     }
 
 
-    kernel->add_module( &u );
+    kernel->add_module( &u, "USB" );
 
     // memory before cache is cleared
     //SimpleShell::print_mem(kernel->streams);
 
+    bool boot_profile= kernel->config->value( boot_profile_checksum )->by_default(false)->as_bool();
+
     // clear up the config cache to save some memory
+    p= BootProfiler::begin("config cache clear");
     kernel->config->config_cache_clear();
+    BootProfiler::end(p);
 
     if(kernel->is_using_leds()) {
         // set some leds to indicate status... led0 init done, led1 mainloop running, led2 idle loop running, led3 sdcard ok
@@ -240,6 +272,7 @@ void init() {
         leds[3]= sdok?1:0; // 4th led indicates sdcard is available (TODO maye should indicate config was found)
     }
 
+    p= BootProfiler::begin("config override");
     if(sdok) {
         // load config override file if present
         // NOTE only Mxxx commands that set values should be put in this file. The file is generated by M500
@@ -257,11 +290,16 @@ void init() {
             fclose(fp);
         }
     }
+    BootProfiler::end(p);
 
     // start the timers and interrupts
     THEKERNEL->conveyor->start(THEROBOT->get_number_registered_motors());
     THEKERNEL->step_ticker->start();
     THEKERNEL->slow_ticker->start();
+    THEKERNEL->pwm_engine->start();
+
+    BootProfiler::finish();
+    if(boot_profile) BootProfiler::dump(kernel->streams);
 }
 
 int main()
@@ -12,7 +12,7 @@ using std::string;
 #include "libs/Kernel.h"
 #include "libs/nuts_bolts.h"
 #include "SerialConsole.h"
-#include "libs/RingBuffer.h"
+#include "libs/SerialLineBuffer.h"
 #include "libs/SerialMessage.h"
 #include "libs/StreamOutput.h"
 #include "libs/StreamOutputPool.h"
@@ -54,7 +54,7 @@ void SerialConsole::on_serial_char_received(){
         }
         // convert CR to NL (for host OSs that don't send NL)
         if( received == '\r' ){ received = '\n'; }
-        this->buffer.push_back(received);
+        this->buffer.receive(received);
     }
 }
 
@@ -77,22 +77,12 @@ void SerialConsole::on_idle(void * argument)
 
 // Actual event calling must happen in the main loop because if it happens in the interrupt we will loose data
 void SerialConsole::on_main_loop(void * argument){
-    if( this->has_char('\n') ){
-        string received;
-        received.reserve(20);
-        while(1){
-           char c;
-           this->buffer.pop_front(c);
-           if( c == '\n' ){
-                struct SerialMessage message;
-                message.message = received;
-                message.stream = this;
-                THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message );
-                return;
-            }else{
-                received += c;
-            }
-        }
+    string received;
+    if( this->buffer.get_line(received) ){
+        struct SerialMessage message;
+        message.message = received;
+        message.stream = this;
+        THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message );
     }
 }
 
@@ -117,14 +107,3 @@ int SerialConsole::_getc()
     return this->serial->getc();
 }
 
-// Does the queue have a given char ?
-bool SerialConsole::has_char(char letter){
-    int index = this->buffer.tail;
-    while( index != this->buffer.head ){
-        if( this->buffer.buffer[index] == letter ){
-            return true;
-        }
-        index = this->buffer.next_block_index(index);
-    }
-    return false;
-}
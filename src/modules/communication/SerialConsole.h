@@ -14,7 +14,7 @@
 #include <vector>
 #include <string>
 using std::string;
-#include "libs/RingBuffer.h"
+#include "libs/SerialLineBuffer.h"
 #include "libs/StreamOutput.h"
 
 
@@ -28,7 +28,6 @@ class SerialConsole : public Module, public StreamOutput {
         void on_serial_char_received();
         void on_main_loop(void * argument);
         void on_idle(void * argument);
-        bool has_char(char letter);
 
         int _putc(int c);
         int _getc(void);
@@ -36,7 +35,7 @@ class SerialConsole : public Module, public StreamOutput {
 
         //string receive_buffer;                 // Received chars are stored here until a newline character is received
         //vector<std::string> received_lines;    // Received lines are stored here until they are requested
-        RingBuffer<char,256> buffer;             // Receive buffer
+        SerialLineBuffer<256> buffer;            // Receive buffer
         mbed::Serial* serial;
         struct {
           bool query_flag:1;
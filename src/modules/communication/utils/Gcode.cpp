@@ -10,19 +10,64 @@
 #include "libs/StreamOutput.h"
 #include "utils.h"
 #include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
 #include <algorithm>
 
+#define GCODE_POOL_SIZE 4
+
+// the command text is shared between copies of a Gcode, with a reference count in front of it
+struct shared_text_t {
+    uint16_t refs;
+    char text[];
+};
+
+#define shared_text(t) ((shared_text_t*)((t) - offsetof(shared_text_t, text)))
+
+// the text of a command there was no memory for, it holds a reference of its own so it is never freed
+static shared_text_t no_text= {1, ""};
+
+// slots for Gcodes made with new, usually only the one GcodeDispatch is working on and any made while it is dispatched
+static uint32_t gcode_pool[GCODE_POOL_SIZE][(sizeof(Gcode) + 3) / 4] __attribute__ ((section ("AHBSRAM0")));
+static uint8_t gcode_pool_used= 0; // bit per slot
+
+static struct {
+    uint16_t live;
+    uint16_t peak;
+    uint32_t heap_fallbacks;
+    uint32_t text_bytes;
+    uint32_t text_peak;
+    uint32_t shared;
+} stats;
+
+static char *share_text(char *t)
+{
+    shared_text(t)->refs++;
+    stats.shared++;
+    return t;
+}
+
+static void release_text(char *t)
+{
+    shared_text_t *s= shared_text(t);
+    if(--s->refs == 0) {
+        stats.text_bytes -= sizeof(shared_text_t) + strlen(t) + 1;
+        free(s);
+    }
+}
+
 // This is a gcode object. It represents a GCode string/command, and caches some important values about that command for the sake of performance.
 // It gets passed around in events, and attached to the queue ( that'll change )
 Gcode::Gcode(const string &command, StreamOutput *stream, bool strip)
 {
-    this->command= strdup(command.c_str());
+    this->command= nullptr;
     this->m= 0;
     this->g= 0;
     this->subcode= 0;
     this->add_nl= false;
     this->is_error= false;
     this->stream= stream;
+    set_command(command.c_str(), command.size());
     prepare_cached_values(strip);
     this->stripped= strip;
 }
@@ -30,14 +75,13 @@ Gcode::Gcode(const string &command, StreamOutput *stream, bool strip)
 Gcode::~Gcode()
 {
     if(command != nullptr) {
-        // TODO we can reference count this so we share copies, may save more ram than the extra count we need to store
-        free(command);
+        release_text(command);
     }
 }
 
 Gcode::Gcode(const Gcode &to_copy)
 {
-    this->command               = strdup(to_copy.command); // TODO we can reference count this so we share copies, may save more ram than the extra count we need to store
+    this->command               = share_text(to_copy.command);
     this->has_m                 = to_copy.has_m;
     this->has_g                 = to_copy.has_g;
     this->m                     = to_copy.m;
@@ -45,6 +89,7 @@ Gcode::Gcode(const Gcode &to_copy)
     this->subcode               = to_copy.subcode;
     this->add_nl                = to_copy.add_nl;
     this->is_error              = to_copy.is_error;
+    this->stripped              = to_copy.stripped;
     this->stream                = to_copy.stream;
     this->txt_after_ok.assign( to_copy.txt_after_ok );
 }
@@ -52,7 +97,9 @@ Gcode::Gcode(const Gcode &to_copy)
 Gcode &Gcode::operator= (const Gcode &to_copy)
 {
     if( this != &to_copy ) {
-        this->command               = strdup(to_copy.command); // TODO we can reference count this so we share copies, may save more ram than the extra count we need to store
+        char *old= this->command;
+        this->command               = share_text(to_copy.command);
+        if(old != nullptr) release_text(old);
         this->has_m                 = to_copy.has_m;
         this->has_g                 = to_copy.has_g;
         this->m                     = to_copy.m;
@@ -60,6 +107,7 @@ Gcode &Gcode::operator= (const Gcode &to_copy)
         this->subcode               = to_copy.subcode;
         this->add_nl                = to_copy.add_nl;
         this->is_error              = to_copy.is_error;
+        this->stripped              = to_copy.stripped;
         this->stream                = to_copy.stream;
         this->txt_after_ok.assign( to_copy.txt_after_ok );
     }
@@ -202,9 +250,7 @@ void Gcode::prepare_cached_values(bool strip)
 
     // remove the Gxxx or Mxxx from string
     if (p != nullptr) {
-        char *n= strdup(p); // create new string starting at end of the numeric value
-        free(command);
-        command= n;
+        set_command(p, strlen(p)); // new string starting at end of the numeric value
     }
 }
 
@@ -234,9 +280,71 @@ void Gcode::strip_parameters()
         // strip whitespace to save even more, this causes problems so don't do it
         //newcmd.erase(std::remove_if(newcmd.begin(), newcmd.end(), ::isspace), newcmd.end());
 
-        // release the old one
-        free(command);
-        // copy the new shortened one
-        command= strdup(newcmd.c_str());
+        // replace with the new shortened one, any copies keep the old one
+        set_command(newcmd.c_str(), newcmd.size());
     }
 }
+
+// replace the command with a new unshared copy of text, text may point into the current command
+void Gcode::set_command(const char *text, size_t len)
+{
+    size_t n= sizeof(shared_text_t) + len + 1;
+    shared_text_t *s= (shared_text_t*)malloc(n);
+    if(s == nullptr) {
+        // fail the command, with no G or M no module acts on it and the dispatcher reports the error
+        if(command != nullptr) release_text(command);
+        command= share_text(no_text.text);
+        has_g= false;
+        has_m= false;
+        is_error= true;
+        txt_after_ok= "out of memory";
+        return;
+    }
+    s->refs= 1;
+    memcpy(s->text, text, len);
+    s->text[len]= '\0';
+
+    if(command != nullptr) release_text(command);
+    command= s->text;
+
+    stats.text_bytes += n;
+    if(stats.text_bytes > stats.text_peak) stats.text_peak= stats.text_bytes;
+}
+
+void* Gcode::operator new(size_t size)
+{
+    void *p= nullptr;
+    for (int i = 0; i < GCODE_POOL_SIZE; ++i) {
+        if((gcode_pool_used & (1 << i)) == 0) {
+            gcode_pool_used |= (1 << i);
+            p= gcode_pool[i];
+            break;
+        }
+    }
+    if(p == nullptr) {
+        p= malloc(size);
+        stats.heap_fallbacks++;
+    }
+
+    if(++stats.live > stats.peak) stats.peak= stats.live;
+    return p;
+}
+
+void Gcode::operator delete(void *p)
+{
+    if(p == nullptr) return;
+    stats.live--;
+
+    uint32_t *w= (uint32_t*)p;
+    if(w >= gcode_pool[0] && w < gcode_pool[GCODE_POOL_SIZE]) {
+        gcode_pool_used &= ~(1 << ((w - gcode_pool[0]) / ((sizeof(Gcode) + 3) / 4)));
+    } else {
+        free(p);
+    }
+}
+
+void Gcode::dump_stats(StreamOutput *stream)
+{
+    stream->printf("Gcodes: %u live, %u peak, %d pooled, %lu from heap\n", stats.live, stats.peak, GCODE_POOL_SIZE, stats.heap_fallbacks);
+    stream->printf("Gcode text: %lu bytes, %lu peak, %lu shared copies\n", stats.text_bytes, stats.text_peak, stats.shared);
+}
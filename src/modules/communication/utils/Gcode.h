@@ -33,6 +33,11 @@ class Gcode {
         std::map<char,int> get_args_int() const;
         void strip_parameters();
 
+        // Gcodes made with new come from a small fixed pool, falling back to the heap when it is all in use
+        static void* operator new(size_t size);
+        static void operator delete(void *p);
+        static void dump_stats(StreamOutput *stream);
+
         // FIXME these should be private
         unsigned int m;
         unsigned int g;
@@ -51,6 +56,9 @@ class Gcode {
 
     private:
         void prepare_cached_values(bool strip=true);
+        void set_command(const char *text, size_t len);
+
+        // shared with copies, reference counted
         char *command;
 };
 #endif
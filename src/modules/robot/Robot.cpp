@@ -48,6 +48,7 @@
 #define  delta_segments_per_second_checksum  CHECKSUM("delta_segments_per_second")
 #define  mm_per_arc_segment_checksum         CHECKSUM("mm_per_arc_segment")
 #define  mm_max_arc_error_checksum           CHECKSUM("mm_max_arc_error")
+#define  mm_max_compensation_error_checksum  CHECKSUM("mm_max_compensation_error")
 #define  arc_correction_checksum             CHECKSUM("arc_correction")
 #define  x_axis_max_speed_checksum           CHECKSUM("x_axis_max_speed")
 #define  y_axis_max_speed_checksum           CHECKSUM("y_axis_max_speed")
@@ -185,6 +186,7 @@ void Robot::load_config()
     this->delta_segments_per_second = THEKERNEL->config->value(delta_segments_per_second_checksum )->by_default(0.0f   )->as_number();
     this->mm_per_arc_segment  = THEKERNEL->config->value(mm_per_arc_segment_checksum  )->by_default(    0.0f)->as_number();
     this->mm_max_arc_error    = THEKERNEL->config->value(mm_max_arc_error_checksum    )->by_default(   0.01f)->as_number();
+    this->mm_max_compensation_error = THEKERNEL->config->value(mm_max_compensation_error_checksum)->by_default(0.0F)->as_number();
     this->arc_correction      = THEKERNEL->config->value(arc_correction_checksum      )->by_default(    5   )->as_number();
 
     // in mm/sec but specified in config as mm/min
@@ -1457,7 +1459,12 @@ bool Robot::append_line(Gcode *gcode, const float target[], float rate_mm_s, flo
     // We cut the line into smaller segments. This is only needed on a cartesian robot for zgrid, but always necessary for robots with rotational axes like Deltas.
     // In delta robots either mm_per_line_segment can be used OR delta_segments_per_second
     // The latter is more efficient and avoids splitting fast long lines into very small segments, like initial z move to 0, it is what Johanns Marlin delta port does
+    // With a leveling strategy that can say where its compensation bends, mm_max_compensation_error splits the line only there
+    // instead, which leaves long moves over flat parts of the bed whole
     uint16_t segments;
+    const int max_splits= 64;
+    float splits[max_splits];
+    int nsplits= -1;
 
     if(this->disable_segmentation || (!segment_z_moves && !gcode->has_letter('X') && !gcode->has_letter('Y'))) {
         segments= 1;
@@ -1472,7 +1479,13 @@ bool Robot::append_line(Gcode *gcode, const float target[], float rate_mm_s, flo
         // TODO if we are only moving in Z on a delta we don't really need to segment at all
 
     } else {
-        if(this->mm_per_line_segment == 0.0F) {
+        if(this->mm_max_compensation_error > 0.0F && compensationTransform && compensationSplits) {
+            nsplits= compensationSplits(machine_position, target, this->mm_max_compensation_error, splits, max_splits);
+        }
+
+        if(nsplits >= 0) {
+            segments = nsplits + 1;
+        } else if(this->mm_per_line_segment == 0.0F) {
             segments = 1; // don't split it up
         } else {
             segments = ceilf( millimeters_of_travel / this->mm_per_line_segment);
@@ -1484,7 +1497,9 @@ bool Robot::append_line(Gcode *gcode, const float target[], float rate_mm_s, flo
         // A vector to keep track of the endpoint of each segment
         float segment_delta[n_motors];
         float segment_end[n_motors];
+        float segment_start[n_motors];
         memcpy(segment_end, machine_position, n_motors*sizeof(float));
+        memcpy(segment_start, machine_position, n_motors*sizeof(float));
 
         // How far do we move each segment?
         for (int i = 0; i < n_motors; i++)
@@ -1494,8 +1509,14 @@ bool Robot::append_line(Gcode *gcode, const float target[], float rate_mm_s, flo
         // We always add another point after this loop so we stop at segments-1, ie i < segments
         for (int i = 1; i < segments; i++) {
             if(THEKERNEL->is_halted()) return false; // don't queue any more segments
-            for (int j = 0; j < n_motors; j++)
-                segment_end[j] += segment_delta[j];
+            if(nsplits >= 0) {
+                // the splits are fractions of the whole line
+                for (int j = 0; j < n_motors; j++)
+                    segment_end[j] = segment_start[j] + (target[j] - segment_start[j]) * splits[i - 1];
+            } else {
+                for (int j = 0; j < n_motors; j++)
+                    segment_end[j] += segment_delta[j];
+            }
 
             // Append the end of this segment to the queue
             // this can block waiting for free block queue or if in feed hold
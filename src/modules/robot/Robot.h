@@ -69,6 +69,9 @@ class Robot : public Module {
 
         // set by a leveling strategy to transform the target of a move according to the current plan
         std::function<void(float*, bool)> compensationTransform;
+        // optionally set with it, gives the fractions of a line from the first position to the second where it has to be
+        // broken for the compensation to stay within tolerance, or -1 if there are more than will fit
+        std::function<int(const float*, const float*, float, float*, int)> compensationSplits;
         // set by an active extruder, returns the amount to scale the E parameter by (to convert mm³ to mm)
         std::function<float(void)> get_e_scale_fnc;
 
@@ -135,6 +138,7 @@ class Robot : public Module {
         float mm_per_line_segment;                           // Setting : Used to split lines into segments
         float mm_per_arc_segment;                            // Setting : Used to split arcs into segments
         float mm_max_arc_error;                              // Setting : Used to limit total arc segments to max error
+        float mm_max_compensation_error;                     // Setting : Used to split lines only where the compensation needs it
         float delta_segments_per_second;                     // Setting : Used to split lines into segments for delta based on speed
         float seconds_per_minute;                            // for realtime speed change
         float default_acceleration;                          // the defualt accleration if not set for each axis
@@ -127,8 +127,8 @@ void Endstops::on_module_loaded()
     }
 
     register_for_event(ON_GCODE_RECEIVED);
-    register_for_event(ON_GET_PUBLIC_DATA);
-    register_for_event(ON_SET_PUBLIC_DATA);
+    register_for_public_data(ON_GET_PUBLIC_DATA, endstops_checksum);
+    register_for_public_data(ON_SET_PUBLIC_DATA, endstops_checksum);
 
 
     THEKERNEL->slow_ticker->attach(1000, this, &Endstops::read_endstops);
@@ -78,10 +78,14 @@ void Extruder::on_module_loaded()
     // Settings
     this->config_load();
 
-    // We work on the same Block as Stepper, so we need to know when it gets a new one and drops one
-    this->register_for_event(ON_GCODE_RECEIVED);
-    this->register_for_event(ON_GET_PUBLIC_DATA);
-    this->register_for_event(ON_SET_PUBLIC_DATA);
+    // only the codes handled in on_gcode_received, G0 and G1 are needed to cancel the zlift restore
+    static const uint16_t m_codes[]= {92, 114, 200, 203, 204, 207, 208, 221, 500, 503};
+    for(auto m : m_codes) this->register_for_gcode('M', m);
+    this->register_for_gcode('G', 0, 1);
+    this->register_for_gcode('G', 10, 11);
+    this->register_for_gcode('G', 92);
+    this->register_for_public_data(ON_GET_PUBLIC_DATA, extruder_checksum);
+    this->register_for_public_data(ON_SET_PUBLIC_DATA, extruder_checksum);
 }
 
 // Get config
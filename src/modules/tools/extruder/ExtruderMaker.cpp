@@ -50,7 +50,7 @@ void ExtruderMaker::load_tools(){
     if(cnt > 1) {
         // ONLY do this if multitool enabled and more than one tool is defined
         toolmanager= new ToolManager();
-        THEKERNEL->add_module( toolmanager );
+        THEKERNEL->add_module( toolmanager, "ToolManager" );
 
     }else{
         // only one extruder so no tool manager required
@@ -67,7 +67,7 @@ void ExtruderMaker::load_tools(){
             Extruder* extruder = new Extruder(cs);
 
             // Add the Extruder module to the kernel
-            THEKERNEL->add_module( extruder );
+            THEKERNEL->add_module( extruder, "extruder" );
 
             if(toolmanager != nullptr) {
                 // Add the extruder module to the ToolsManager if it was created
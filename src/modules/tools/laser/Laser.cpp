@@ -111,7 +111,7 @@ void Laser::on_module_loaded()
     this->register_for_event(ON_HALT);
     this->register_for_event(ON_GCODE_RECEIVED);
     this->register_for_event(ON_CONSOLE_LINE_RECEIVED);
-    this->register_for_event(ON_GET_PUBLIC_DATA);
+    this->register_for_public_data(ON_GET_PUBLIC_DATA, laser_checksum);
 
     // no point in updating the power more than the PWM frequency, but not faster than 1KHz
     ms_per_tick = 1000 / std::min(1000UL, 1000000 / period);
@@ -85,15 +85,10 @@ int BufferedSoftSerial::printf(const char* format, ...)
 
 ssize_t BufferedSoftSerial::write(const void *s, size_t length)
 {
-    const char* ptr = (const char*)s;
-    const char* end = ptr + length;
-
-    while (ptr != end) {
-        _txbuf.push_back(*(ptr++));
-    }
+    size_t n = _txbuf.push_back((const char*)s, length);
     BufferedSoftSerial::prime();
 
-    return ptr - (const char*)s;
+    return n;
 }
 
 
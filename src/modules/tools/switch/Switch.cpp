@@ -15,6 +15,7 @@
 #include "PublicDataRequest.h"
 #include "SwitchPublicAccess.h"
 #include "SlowTicker.h"
+#include "PwmEngine.h"
 #include "Config.h"
 #include "Gcode.h"
 #include "checksumm.h"
@@ -79,10 +80,9 @@ void Switch::on_module_loaded()
 {
     this->switch_changed = false;
 
-    this->register_for_event(ON_GCODE_RECEIVED);
     this->register_for_event(ON_MAIN_LOOP);
-    this->register_for_event(ON_GET_PUBLIC_DATA);
-    this->register_for_event(ON_SET_PUBLIC_DATA);
+    this->register_for_public_data(ON_GET_PUBLIC_DATA, switch_checksum, this->name_checksum);
+    this->register_for_public_data(ON_SET_PUBLIC_DATA, switch_checksum, this->name_checksum);
     this->register_for_event(ON_HALT);
 
     // Settings
@@ -265,10 +265,14 @@ void Switch::on_config_reload(void *argument)
         }
     }
 
+    // we only need to see our on and off commands, drop the ones from before if the config is read again
+    this->unregister_for_gcode();
+    if(input_on_command_letter != 0) this->register_for_gcode(input_on_command_letter, input_on_command_code);
+    if(input_off_command_letter != 0) this->register_for_gcode(input_off_command_letter, input_off_command_code);
 
     if(this->output_type == SIGMADELTA) {
         // SIGMADELTA
-        THEKERNEL->slow_ticker->attach(1000, this->sigmadelta_pin, &Pwm::on_tick);
+        THEKERNEL->pwm_engine->attach(this->sigmadelta_pin, 1000);
     }
 
     // for commands we need to replace _ for space
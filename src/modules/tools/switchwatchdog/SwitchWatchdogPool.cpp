@@ -28,7 +28,7 @@ void SwitchWatchdogPool::load_tools()
         // If module is enabled
         if( THEKERNEL->config->value(switchwatchdog_checksum, modules[i], enable_checksum )->as_bool() == true ) {
             SwitchWatchdog *controller = new SwitchWatchdog(modules[i]);
-            THEKERNEL->add_module(controller);
+            THEKERNEL->add_module(controller, "switchwatchdog");
         }
     }
 
@@ -0,0 +1,143 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "MPC_Controller.h"
+
+#include <math.h>
+
+// how quickly in seconds the model is pulled onto the measured temperature, long enough to smooth out the sensor noise
+#define CORRECTION_TIME 1.0F
+// how long in seconds a steady error takes to be taken up by the disturbance
+#define INTEGRAL_TIME 20.0F
+// and how close in °C to the target it has to be first
+#define INTEGRAL_BAND 5.0F
+// the most the disturbance can make up for, as a fraction of full power
+#define MAX_DISTURBANCE 0.5F
+
+MPC_Controller::MPC_Controller()
+{
+    gain= 0;
+    time_constant= 0;
+    dead_time= 0;
+    ambient= 25;
+    fan_loss= 0;
+    filament_loss= 0;
+    horizon= 0;
+    load= 1;
+    decay= 0;
+    decay_for= -1;
+    reset(ambient, 0);
+}
+
+void MPC_Controller::reset(float temperature, float duty)
+{
+    block= sensor= temperature - ambient;
+    disturbance= 0;
+    last_duty= duty;
+}
+
+void MPC_Controller::set_load(float fan, float filament_rate)
+{
+    if(fan < 0) fan= 0; else if(fan > 1) fan= 1;
+    if(filament_rate < 0) filament_rate= 0;
+    load= 1.0F + fan_loss * fan + filament_loss * filament_rate;
+}
+
+float MPC_Controller::update(float target, float temperature, float dt, float max_duty)
+{
+    if(!is_valid()) return 0;
+
+    // run the model on over the last interval with the duty we actually applied
+    block += (dt / time_constant) * (gain * (last_duty + disturbance) - load * block);
+    if(dead_time > dt) {
+        sensor += (dt / dead_time) * (block - sensor);
+    } else {
+        sensor= block;
+    }
+
+    // pull it onto the reading, an error that keeps coming back is heat the model does not know about
+    // a disturbance off by d makes the model drift by gain * d / time_constant per second, which the correction holds at an error
+    // of gain * d * CORRECTION_TIME / time_constant, so this takes it up over INTEGRAL_TIME
+    float error= (temperature - ambient) - sensor;
+    float c= dt / CORRECTION_TIME;
+    if(c > 1) c= 1;
+    block += error * c;
+    sensor += error * c;
+    // only near the target though, while heating up the error is mostly the dead time approximation and would wind it up
+    if(fabsf(target - temperature) < INTEGRAL_BAND) {
+        disturbance += error * c * time_constant / (gain * INTEGRAL_TIME);
+    }
+    if(disturbance > MAX_DISTURBANCE) disturbance= MAX_DISTURBANCE;
+    else if(disturbance < -MAX_DISTURBANCE) disturbance= -MAX_DISTURBANCE;
+
+    // the duty that takes the block from where it is now to the target in horizon seconds
+    float h= horizon > dt ? horizon : dt;
+    float a= load * h / time_constant;
+    if(a != decay_for) {
+        decay= expf(-a);
+        decay_for= a;
+    }
+    float duty= load * ((target - ambient) - block * decay) / (gain * (1.0F - decay)) - disturbance;
+
+    if(duty > max_duty) duty= max_duty;
+    else if(duty < 0) duty= 0;
+    last_duty= duty;
+    return duty;
+}
+
+// While off the reading carries on up for the dead time then decays towards ambient, and while on it carries on down for the
+// dead time then rises towards gain * duty, so
+//   trough = switch_on * exp(-dead_time / time_constant)
+//   peak = gain * duty - (gain * duty - switch_off) * exp(-dead_time / time_constant)
+//   cool_time = dead_time + time_constant * ln(peak / switch_on)
+// which gives time_constant = cool_time / ln(peak / trough) and the rest follows
+bool MPC_Controller::fit_relay_cycle(float switch_off, float switch_on, float peak, float trough, float cool_time, float duty)
+{
+    if(duty <= 0 || cool_time <= 0 || trough <= 0 || !(trough < switch_on) || !(switch_on <= switch_off) || !(switch_off < peak)) return false;
+
+    float tc= cool_time / logf(peak / trough);
+    float e= trough / switch_on; // exp(-dead_time / time_constant)
+    float g= (peak - switch_off * e) / ((1.0F - e) * duty);
+    if(!(tc > 0) || !(g > peak)) return false;
+
+    this->time_constant= tc;
+    this->dead_time= -tc * logf(e);
+    this->gain= g;
+    this->decay_for= -1;
+    return true;
+}
+
+float MPC_Controller::predicted_heat_time(float switch_off, float trough, float duty) const
+{
+    float top= gain * duty;
+    if(!is_valid() || top <= switch_off) return 0;
+    return dead_time + time_constant * logf((top - trough) / (top - switch_off));
+}
+
+// Skogestad's IMC rules for a first order plus dead time plant, with a derivative for the dead time
+//   kp = (time_constant + dead_time / 2) / (K * (lambda + dead_time / 2))
+//   ti = min(time_constant + dead_time / 2, 4 * (lambda + dead_time))
+//   td = time_constant * dead_time / (2 * time_constant + dead_time)
+// where K is the rise in °C for one step of the output. A heater block is lag dominant so the plain IMC integral time is
+// the time constant, which leaves the integral so slow that whatever it winds up while heating takes minutes to unwind,
+// capping it at 4 * (lambda + dead_time) brings it back in a couple of oscillations at most
+void MPC_Controller::pid_gains(float full_scale, float lambda, float& kp, float& ki, float& kd) const
+{
+    if(!is_valid() || full_scale <= 0) {
+        kp= ki= kd= 0;
+        return;
+    }
+    if(lambda < dead_time) lambda= dead_time;
+
+    float k= gain / full_scale;
+    float ti= time_constant + dead_time / 2;
+    float td= time_constant * dead_time / (2 * time_constant + dead_time);
+    kp= ti / (k * (lambda + dead_time / 2));
+    if(ti > 4 * (lambda + dead_time)) ti= 4 * (lambda + dead_time);
+    ki= kp / ti;
+    kd= kp * td;
+}
@@ -0,0 +1,74 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MPC_CONTROLLER_H
+#define MPC_CONTROLLER_H
+
+// Model predictive heater control based on a first order plus dead time model of the heater block.
+//
+//   time_constant * d(block)/dt = gain * (duty + disturbance) - load * block
+//   dead_time * d(sensor)/dt = block - sensor
+//
+// where block and sensor are temperatures above ambient, duty is 0..1 and the dead time is approximated by a lag on the
+// sensor, so no history needs to be kept. load is 1 in still air and rises with the part cooling fan and with filament
+// being pushed through, which is the feed forward.
+// Every reading the model is run forward and pulled towards the measured temperature, the part of the error it can not
+// explain is taken up slowly by disturbance so there is no steady state offset when the model is not quite right.
+// The duty is then chosen so the modelled block would just reach the target after horizon seconds. While far away that is
+// more than full power so it heats as fast as it can, and as the block nears the target it backs off in time for the
+// heat still on its way to the sensor, so it does not overshoot.
+class MPC_Controller
+{
+    public:
+        MPC_Controller();
+
+        bool is_valid() const { return gain > 0 && time_constant > 0; }
+
+        // start the model from a settled reading, eg when the heater is turned on
+        void reset(float temperature, float duty);
+        // fan is 0..1, filament_rate is in mm/s
+        void set_load(float fan, float filament_rate);
+        // returns the duty 0..max_duty to apply until the next reading dt seconds later
+        float update(float target, float temperature, float dt, float max_duty= 1.0F);
+
+        // fit the model to one relay cycle of an autotune run around a target, temperatures are above ambient
+        // the heater was turned off when the reading rose past switch_off and on again when it fell past switch_on, the
+        // reading then kept going to peak and trough because of the dead time, and it spent cool_time from turning off
+        // to turning back on. duty is what the heater was run at while on
+        bool fit_relay_cycle(float switch_off, float switch_on, float peak, float trough, float cool_time, float duty);
+        // how long the model says the heating part of the same cycle should take, to check the fit against
+        float predicted_heat_time(float switch_off, float trough, float duty) const;
+        // PID gains for the same plant, for an output of 0..full_scale and a closed loop time constant of lambda seconds,
+        // which is kept to at least the dead time to stay robust
+        void pid_gains(float full_scale, float lambda, float& kp, float& ki, float& kd) const;
+
+        float get_disturbance() const { return disturbance; }
+        float get_load() const { return load; }
+
+        // plant model, gain is the temperature rise above ambient at full power in °C, times are in seconds
+        float gain;
+        float time_constant;
+        float dead_time;
+        float ambient;
+        // extra heat loss at full fan and per mm/s of filament, as a fraction of the loss in still air
+        float fan_loss;
+        float filament_loss;
+        // how far ahead in seconds the target should be met, longer is gentler
+        float horizon;
+
+    private:
+        float block;
+        float sensor;
+        float disturbance;
+        float last_duty;
+        float load;
+        // exp(-load * horizon / time_constant), only changes with the load or the settings
+        float decay;
+        float decay_for;
+};
+
+#endif
@@ -8,8 +8,10 @@
 #include "TemperatureControlPublicAccess.h"
 #include "PublicDataRequest.h"
 #include "PublicData.h"
+#include "MPC_Controller.h"
 
 #include <cmath>        // std::abs
+#include <algorithm>
 
 //#define DEBUG_PRINTF s->printf
 #define DEBUG_PRINTF(...)
@@ -60,6 +62,12 @@ void PID_Autotuner::begin(float target, int ncycles)
     justchanged = false;
     firstPeak= false;
     output= 0;
+
+    // we should be starting cold, the heat lost to the room is worked out from this
+    ambient= temp_control->get_temperature();
+    switched_off= switched_on= false;
+    have_cool= have_heat= false;
+    relay_cycles= 0;
 }
 
 void PID_Autotuner::abort()
@@ -127,11 +135,19 @@ void PID_Autotuner::on_gcode_received(void *argument)
                 nLookBack = gcode->get_value('L');
             }
 
+            // F1 fits a model to two relay cycles and works the gains out from that instead of waiting for the oscillation to settle
+            bool fast_tune = gcode->has_letter('F') && gcode->get_int('F') != 0;
+
             gcode->stream->printf("Start PID tune for index E%d, designator: %s\n", pool_index, this->temp_control->designator.c_str());
 
             this->begin(target, ncycles);
+            this->fast = fast_tune;
 
-            gcode->stream->printf("%s: Starting PID Autotune, %d max cycles, M304 aborts\n", temp_control->designator.c_str(), ncycles);
+            if(fast) {
+                gcode->stream->printf("%s: Starting fast PID Autotune, 2 cycles, M304 aborts\n", temp_control->designator.c_str());
+            } else {
+                gcode->stream->printf("%s: Starting PID Autotune, %d max cycles, M304 aborts\n", temp_control->designator.c_str(), ncycles);
+            }
         }
     }
 }
@@ -166,6 +182,7 @@ void PID_Autotuner::on_idle(void *)
     }
 
     float refVal = temp_control->get_temperature();
+    int last_output= output;
 
     // oscillate the output base on the input's relation to the setpoint
     if (refVal > target_temperature + noiseBand) {
@@ -183,6 +200,37 @@ void PID_Autotuner::on_idle(void *)
         temp_control->heater_pin.pwm(output);
     }
 
+    // time each half of the relay cycle and how far past the switching point the dead time carries the temperature
+    if(last_output > 0 && output == 0) {
+        if(switched_on) {
+            last_heat_time= (tickCnt - heater_on_tick) / 1000.0F;
+            last_trough= relay_trough;
+            have_heat= true;
+            ++relay_cycles;
+        }
+        switched_off= true;
+        heater_off_tick= tickCnt;
+        relay_peak= refVal;
+
+    } else if(last_output == 0 && output > 0) {
+        if(switched_off) {
+            last_cool_time= (tickCnt - heater_off_tick) / 1000.0F;
+            last_peak= relay_peak;
+            have_cool= true;
+        }
+        switched_on= true;
+        heater_on_tick= tickCnt;
+        relay_trough= refVal;
+    }
+    if(output == 0 && refVal > relay_peak) relay_peak= refVal;
+    if(output > 0 && refVal < relay_trough) relay_trough= refVal;
+
+    // the first cycle starts from the overshoot of the warm up, the second is settled enough to fit
+    if(fast && relay_cycles >= 2) {
+        finish_fast();
+        return;
+    }
+
     if ((tickCnt % 1000) == 0) {
         THEKERNEL->streams->printf("// Autopid Status - %5.1f/%5.1f @%d %d/%d\n",  refVal, target_temperature, output, peakCount, requested_cycles);
     }
@@ -269,6 +317,10 @@ void PID_Autotuner::finishUp()
     temp_control->setPIDi(ki);
     temp_control->setPIDd(kd);
 
+    MPC_Controller fit;
+    float error;
+    if(fit_model(fit, error)) load_model(fit);
+
     THEKERNEL->streams->printf("PID Autotune Complete! The settings above have been loaded into memory, but not written to your config file.\n");
 
 
@@ -285,3 +337,92 @@ void PID_Autotuner::finishUp()
         delete[] lastInputs;
     lastInputs = NULL;
 }
+
+// work the PID gains out from a model fitted to the last relay cycle
+void PID_Autotuner::finish_fast()
+{
+    MPC_Controller fit;
+    float error;
+    if(!fit_model(fit, error) || error > 0.25F) {
+        THEKERNEL->streams->printf("// WARNING: the model does not fit well enough to tune from, carrying on with a full autotune\n");
+        fast= false;
+        return;
+    }
+
+    // the loop is made as fast as the dead time allows
+    float kp, ki, kd;
+    fit.pid_gains(255, fit.dead_time, kp, ki, kd);
+    // the integral only has to make up the heat lost at the target, twice that leaves room for the fan without letting it
+    // wind up much while heating, as the PID keeps integrating when the output is saturated
+    float hold= (target_temperature - fit.ambient) * 255 / fit.gain;
+    float imax= std::min(2 * hold, (float)temp_control->heater_pin.max_pwm());
+
+    THEKERNEL->streams->printf("\tTrying:\n\tKp: %5.1f\n\tKi: %5.3f\n\tKd: %5.0f\n\tI_max: %5.0f\n", kp, ki, kd, imax);
+    THEKERNEL->streams->printf("\tM301 S%d P%1.4f I%1.4f D%1.4f X%1.4f\n", temp_control->pool_index, kp, ki, kd, imax);
+
+    temp_control->setPIDp(kp);
+    temp_control->setPIDi(ki);
+    temp_control->setPIDd(kd);
+    temp_control->i_max= imax;
+
+    load_model(fit);
+
+    // a full run needs four peaks after the look back is filled, and may take all the cycles it was given
+    float took= tickCnt / 1000.0F;
+    float cycle= last_cool_time + last_heat_time;
+    float least= 2 * cycle + nLookBack * 20 / 1000.0F;
+    float most= (requested_cycles - 2) * cycle + nLookBack * 20 / 1000.0F;
+    THEKERNEL->streams->printf("\tFast autotune took %1.0fs, a full one would have taken at least %1.0fs and up to %1.0fs more\n", took, least, most);
+
+    THEKERNEL->streams->printf("PID Autotune Complete! The settings above have been loaded into memory, but not written to your config file.\n");
+
+    // and clean up
+    abort();
+}
+
+// fit the first order plus dead time model used by MPC to the last relay cycle, error is how far off the model is
+// when it predicts the heating half of the cycle, which the fit did not use
+bool PID_Autotuner::fit_model(MPC_Controller& fit, float& error)
+{
+    if(!(have_cool && have_heat)) {
+        THEKERNEL->streams->printf("// Not enough relay cycles to fit a model for MPC\n");
+        return false;
+    }
+    if(ambient > 40) {
+        THEKERNEL->streams->printf("// WARNING: started at %5.1f, the model will be off unless autotune is started cold\n", ambient);
+    }
+
+    // fit into a copy so a bad run does not spoil a model that is in use, and a machine without MPC does not get one
+    if(temp_control->mpc != nullptr) fit= *temp_control->mpc;
+    fit.ambient= ambient;
+    float duty= oStep / 255.0F;
+    float off= target_temperature + noiseBand - ambient;
+    float on= target_temperature - noiseBand - ambient;
+    if(!fit.fit_relay_cycle(off, on, last_peak - ambient, last_trough - ambient, last_cool_time, duty)) {
+        THEKERNEL->streams->printf("// Could not fit a model to peak %g, trough %g, cooling %gs\n", last_peak, last_trough, last_cool_time);
+        return false;
+    }
+
+    float predicted= fit.predicted_heat_time(off, last_trough - ambient, duty);
+    error= fabsf(predicted - last_heat_time) / last_heat_time;
+    THEKERNEL->streams->printf("\tModel: gain %1.1f, time constant %1.1fs, dead time %1.2fs, ambient %1.1f\n", fit.gain, fit.time_constant, fit.dead_time, fit.ambient);
+    THEKERNEL->streams->printf("\tHeating took %1.1fs, model says %1.1fs, %1.0f%% off\n", last_heat_time, predicted, error * 100);
+    return true;
+}
+
+// load a fitted model for MPC if it is configured and not already in use, otherwise just say how to load it
+void PID_Autotuner::load_model(const MPC_Controller& fit)
+{
+    MPC_Controller *mpc= temp_control->mpc;
+    if(mpc == nullptr || (temp_control->use_mpc && mpc->is_valid())) {
+        THEKERNEL->streams->printf("\tMPC model not loaded, use M307 S%d K%1.4f T%1.4f D%1.4f A%1.4f P1 to load it and switch to MPC\n", temp_control->pool_index, fit.gain, fit.time_constant, fit.dead_time, fit.ambient);
+        return;
+    }
+
+    // the horizon follows the dead time unless it was set to something else
+    float horizon= (mpc->horizon == mpc->dead_time) ? fit.dead_time : mpc->horizon;
+    *mpc= fit;
+    mpc->horizon= horizon;
+    mpc->reset(temp_control->get_temperature(), 0);
+    THEKERNEL->streams->printf("\tM307 S%d K%1.4f T%1.4f D%1.4f A%1.4f (use M307 S%d P1 to switch to MPC)\n", temp_control->pool_index, fit.gain, fit.time_constant, fit.dead_time, fit.ambient, temp_control->pool_index);
+}
@@ -10,6 +10,7 @@
 #include "Module.h"
 
 class TemperatureControl;
+class MPC_Controller;
 
 class PID_Autotuner : public Module
 {
@@ -25,6 +26,9 @@ private:
     void begin(float, int );
     void abort();
     void finishUp();
+    void finish_fast();
+    bool fit_model(MPC_Controller& fit, float& error);
+    void load_model(const MPC_Controller& fit);
 
     TemperatureControl *temp_control;
     float target_temperature;
@@ -43,10 +47,24 @@ private:
     float oStep;
     int output;
     volatile unsigned long tickCnt;
+
+    // the last relay cycle for fitting the MPC model
+    float ambient;
+    float relay_peak, relay_trough;
+    float last_peak, last_trough;
+    unsigned long heater_off_tick, heater_on_tick;
+    float last_cool_time, last_heat_time;
+    int relay_cycles;
+
     struct {
         bool justchanged:1;
         volatile bool tick:1;
         bool firstPeak:1;
+        bool switched_off:1;
+        bool switched_on:1;
+        bool have_cool:1;
+        bool have_heat:1;
+        bool fast:1;
     };
 };
 
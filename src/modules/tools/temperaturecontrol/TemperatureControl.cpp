@@ -21,8 +21,13 @@
 #include "checksumm.h"
 #include "Gcode.h"
 #include "SlowTicker.h"
+#include "PwmEngine.h"
 #include "ConfigValue.h"
 #include "PID_Autotuner.h"
+#include "MPC_Controller.h"
+#include "TemperatureTelemetry.h"
+#include "SwitchPublicAccess.h"
+#include "ExtruderPublicAccess.h"
 #include "SerialMessage.h"
 #include "utils.h"
 
@@ -68,6 +73,16 @@
 #define runaway_cooling_timeout_checksum   CHECKSUM("runaway_cooling_timeout")
 #define runaway_error_range_checksum       CHECKSUM("runaway_error_range")
 
+#define mpc_checksum                       CHECKSUM("mpc")
+#define mpc_gain_checksum                  CHECKSUM("mpc_gain")
+#define mpc_time_constant_checksum         CHECKSUM("mpc_time_constant")
+#define mpc_dead_time_checksum             CHECKSUM("mpc_dead_time")
+#define mpc_ambient_checksum               CHECKSUM("mpc_ambient")
+#define mpc_fan_loss_checksum              CHECKSUM("mpc_fan_loss")
+#define mpc_filament_loss_checksum         CHECKSUM("mpc_filament_loss")
+#define mpc_horizon_checksum               CHECKSUM("mpc_horizon")
+#define mpc_fan_switch_checksum            CHECKSUM("mpc_fan_switch")
+
 TemperatureControl::TemperatureControl(uint16_t name, int index)
 {
     name_checksum= name;
@@ -77,11 +92,15 @@ TemperatureControl::TemperatureControl(uint16_t name, int index)
     sensor= nullptr;
     readonly= false;
     tick= 0;
+    active= false;
+    mpc= nullptr;
+    use_mpc= false;
 }
 
 TemperatureControl::~TemperatureControl()
 {
     delete sensor;
+    delete mpc;
 }
 
 void TemperatureControl::on_module_loaded()
@@ -94,15 +113,23 @@ void TemperatureControl::on_module_loaded()
     // Settings
     this->load_config();
 
-    // Register for events
-    this->register_for_event(ON_GCODE_RECEIVED);
-    this->register_for_event(ON_GET_PUBLIC_DATA);
+    // Register for events, there can be many of these so only ask for the M codes we handle
+    this->register_for_gcode('M', this->get_m_code);
+    this->register_for_gcode('M', this->set_m_code);
+    this->register_for_gcode('M', this->set_and_wait_m_code);
+    this->register_for_gcode('M', 143);
+    this->register_for_gcode('M', 301);
+    this->register_for_gcode('M', 305);
+    this->register_for_gcode('M', 307);
+    this->register_for_gcode('M', 500);
+    this->register_for_gcode('M', 503);
+    this->register_for_public_data(ON_GET_PUBLIC_DATA, temperature_control_checksum);
     this->register_for_event(ON_IDLE);
 
     if(!this->readonly) {
         this->register_for_event(ON_SECOND_TICK);
         this->register_for_event(ON_MAIN_LOOP);
-        this->register_for_event(ON_SET_PUBLIC_DATA);
+        this->register_for_public_data(ON_SET_PUBLIC_DATA, temperature_control_checksum, this->name_checksum);
         this->register_for_event(ON_HALT);
     }
 }
@@ -209,7 +236,7 @@ void TemperatureControl::load_config()
         this->heater_pin.set(0);
         set_low_on_debug(heater_pin.port_number, heater_pin.pin);
         // activate SD-DAC timer
-        THEKERNEL->slow_ticker->attach( THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, pwm_frequency_checksum)->by_default(2000)->as_number(), &heater_pin, &Pwm::on_tick);
+        THEKERNEL->pwm_engine->attach( &heater_pin, THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, pwm_frequency_checksum)->by_default(2000)->as_number() );
     }
 
 
@@ -225,6 +252,28 @@ void TemperatureControl::load_config()
     if(!this->readonly) {
         // set to the same as max_pwm by default
         this->i_max = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, i_max_checksum   )->by_default(this->heater_pin.max_pwm())->as_number();
+
+        // model predictive control, the model is normally found with M303 and saved with M500
+        this->use_mpc = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, mpc_checksum)->by_default(false)->as_bool();
+        float gain = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, mpc_gain_checksum)->by_default(0)->as_number();
+        if(this->use_mpc || gain > 0) {
+            delete mpc;
+            mpc = new MPC_Controller();
+            mpc->gain          = gain;
+            mpc->time_constant = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, mpc_time_constant_checksum)->by_default(0)->as_number();
+            mpc->dead_time     = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, mpc_dead_time_checksum)->by_default(0)->as_number();
+            mpc->ambient       = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, mpc_ambient_checksum)->by_default(25)->as_number();
+            mpc->fan_loss      = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, mpc_fan_loss_checksum)->by_default(0)->as_number();
+            mpc->filament_loss = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, mpc_filament_loss_checksum)->by_default(0)->as_number();
+            // by default aim to meet the target one dead time ahead
+            mpc->horizon       = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, mpc_horizon_checksum)->by_default(mpc->dead_time)->as_number();
+            this->mpc_fan_switch = get_checksum(THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, mpc_fan_switch_checksum)->by_default("fan")->as_string());
+            this->mpc_last_filament = 0;
+
+            if(this->use_mpc && !mpc->is_valid()) {
+                THEKERNEL->streams->printf("WARNING: %s has mpc set but no model, using PID until M303 has been run\n", designator.c_str());
+            }
+        }
     }
 
     this->iTerm = 0.0;
@@ -261,7 +310,7 @@ void TemperatureControl::on_gcode_received(void *argument)
                 }
 
             }else if(!gcode->has_letter('S')) {
-                gcode->stream->printf("%s(S%d): using %s\n", this->designator.c_str(), this->pool_index, this->readonly?"Readonly" : this->use_bangbang?"Bangbang":"PID");
+                gcode->stream->printf("%s(S%d): using %s\n", this->designator.c_str(), this->pool_index, this->readonly?"Readonly" : this->use_bangbang?"Bangbang": (this->use_mpc && mpc != nullptr && mpc->is_valid())?"MPC":"PID");
                 sensor->get_raw();
                 TempSensor::sensor_options_t options;
                 if(sensor->get_optional(options)) {
@@ -308,9 +357,48 @@ void TemperatureControl::on_gcode_received(void *argument)
                 gcode->stream->printf("%s(S%d): Pf:%g If:%g Df:%g X(I_max):%g Y(max pwm):%d O:%d\n", this->designator.c_str(), this->pool_index, this->p_factor, this->i_factor / this->PIDdt, this->d_factor * this->PIDdt, this->i_max, this->heater_pin.max_pwm(), o);
             }
 
+        } else if (gcode->m == 307) {
+            if (gcode->has_letter('S') && (gcode->get_value('S') == this->pool_index)) {
+                make_mpc();
+                bool horizon_set= gcode->has_letter('H');
+                if (gcode->has_letter('K')) mpc->gain= gcode->get_value('K');
+                if (gcode->has_letter('T')) mpc->time_constant= gcode->get_value('T');
+                if (gcode->has_letter('D')) {
+                    // the horizon follows the dead time unless it is set too
+                    if(!horizon_set && mpc->horizon == mpc->dead_time) mpc->horizon= gcode->get_value('D');
+                    mpc->dead_time= gcode->get_value('D');
+                }
+                if (gcode->has_letter('A')) mpc->ambient= gcode->get_value('A');
+                if (gcode->has_letter('F')) mpc->fan_loss= gcode->get_value('F');
+                if (gcode->has_letter('E')) mpc->filament_loss= gcode->get_value('E');
+                if (horizon_set) mpc->horizon= gcode->get_value('H');
+                if (gcode->has_letter('P')) {
+                    this->use_mpc= gcode->get_value('P') != 0;
+                    // start the model from where we are
+                    mpc->reset(last_reading, o / 255.0F);
+                }
+                if(this->use_mpc && !mpc->is_valid()) {
+                    gcode->stream->printf("WARNING: no model set, using PID until M303 has been run\n");
+                }
+
+            }else if(!gcode->has_letter('S')) {
+                if(mpc == nullptr) {
+                    gcode->stream->printf("%s(S%d): no model\n", this->designator.c_str(), this->pool_index);
+                } else {
+                    gcode->stream->printf("%s(S%d): %s K(gain):%g T(time constant):%g D(dead time):%g A(ambient):%g F(fan loss):%g E(filament loss):%g H(horizon):%g load:%g disturbance:%g\n",
+                        this->designator.c_str(), this->pool_index, this->use_mpc?"MPC":"PID", mpc->gain, mpc->time_constant, mpc->dead_time, mpc->ambient,
+                        mpc->fan_loss, mpc->filament_loss, mpc->horizon, mpc->get_load(), mpc->get_disturbance());
+                }
+            }
+
         } else if (gcode->m == 500 || gcode->m == 503) { // M500 saves some volatile settings to config override file, M503 just prints the settings
             gcode->stream->printf(";PID settings, i_max, max_pwm:\nM301 S%d P%1.4f I%1.4f D%1.4f X%1.4f Y%d\n", this->pool_index, this->p_factor, this->i_factor / this->PIDdt, this->d_factor * this->PIDdt, this->i_max, this->heater_pin.max_pwm());
 
+            if(mpc != nullptr) {
+                gcode->stream->printf(";MPC model and mode:\nM307 S%d K%1.4f T%1.4f D%1.4f A%1.4f F%1.4f E%1.4f H%1.4f P%d\n", this->pool_index,
+                    mpc->gain, mpc->time_constant, mpc->dead_time, mpc->ambient, mpc->fan_loss, mpc->filament_loss, mpc->horizon, this->use_mpc?1:0);
+            }
+
             gcode->stream->printf(";Max temperature setting:\nM143 S%d P%1.4f\n", this->pool_index, this->max_temp);
 
             if(this->sensor_settings) {
@@ -461,6 +549,7 @@ void TemperatureControl::set_desired_temperature(float desired_temperature)
         this->iTerm= this->o;
         if (this->iTerm > this->i_max) this->iTerm = this->i_max;
         else if (this->iTerm < 0.0) this->iTerm = 0.0;
+        if(mpc != nullptr) mpc->reset(last_reading, this->o / 255.0F);
     }
 
     // reset the runaway state, even if it was a temp change
@@ -486,6 +575,7 @@ uint32_t TemperatureControl::thermistor_read_tick(uint32_t dummy)
     }
 
     last_reading = temperature;
+    TemperatureTelemetry::sample(this->pool_index, this->designator.c_str(), temperature, target_temperature, this->o);
     return 0;
 }
 
@@ -515,6 +605,15 @@ void TemperatureControl::pid_process(float temperature)
         return;
     }
 
+    if(use_mpc && mpc != nullptr && mpc->is_valid()) {
+        // the model works in fractions of full power so max_pwm is just a limit on it
+        float duty= mpc->update(target_temperature, temperature, this->PIDdt, heater_pin.max_pwm() / 255.0F);
+        this->o = lroundf(duty * 255);
+        this->heater_pin.pwm(this->o);
+        this->lastInput = temperature;
+        return;
+    }
+
     // regular PID control
     float error = target_temperature - temperature;
 
@@ -547,6 +646,8 @@ void TemperatureControl::on_second_tick(void *argument)
     if (waiting)
         THEKERNEL->streams->printf("%s:%3.1f /%3.1f @%d\n", designator.c_str(), get_temperature(), ((target_temperature <= 0) ? 0.0 : target_temperature), o);
 
+    if(use_mpc && mpc != nullptr) update_mpc_load();
+
     // Check whether or not there is a temperature runaway issue, if so stop everything and report it
     if(THEKERNEL->is_halted()) return;
 
@@ -614,6 +715,40 @@ void TemperatureControl::on_second_tick(void *argument)
     }
 }
 
+// the model when it was not in the config
+MPC_Controller *TemperatureControl::make_mpc()
+{
+    if(mpc == nullptr) {
+        mpc= new MPC_Controller();
+        mpc_fan_switch= fan_checksum;
+        mpc_last_filament= 0;
+    }
+    return mpc;
+}
+
+// feed forward for the MPC, done here as public data can not be asked for from the reading tick
+void TemperatureControl::update_mpc_load()
+{
+    float fan= 0;
+    struct pad_switch pad;
+    if(mpc->fan_loss != 0 && PublicData::get_value(switch_checksum, this->mpc_fan_switch, 0, &pad) && pad.state) {
+        // a switch that is not pwm just says on
+        fan= (pad.value > 0) ? pad.value / 255.0F : 1.0F;
+    }
+
+    // how fast filament has gone into the selected extruder over the last second, if we are the heater for it
+    float rate= 0;
+    pad_extruder_t rd;
+    if(mpc->filament_loss != 0 && this->active && PublicData::get_value(extruder_checksum, (void *)&rd)) {
+        rate= rd.current_position - this->mpc_last_filament;
+        // retracts and position resets are not load
+        if(rate < 0 || rate > 100) rate= 0;
+        this->mpc_last_filament= rd.current_position;
+    }
+
+    mpc->set_load(fan, rate);
+}
+
 void TemperatureControl::setPIDp(float p)
 {
     this->p_factor = p;
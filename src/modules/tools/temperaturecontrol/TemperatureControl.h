@@ -13,6 +13,8 @@
 #include "TempSensor.h"
 #include "TemperatureControlPublicAccess.h"
 
+class MPC_Controller;
+
 class TemperatureControl : public Module {
 
     public:
@@ -42,6 +44,8 @@ class TemperatureControl : public Module {
         void setPIDp(float p);
         void setPIDi(float i);
         void setPIDd(float d);
+        void update_mpc_load();
+        MPC_Controller *make_mpc();
 
         int pool_index;
 
@@ -72,6 +76,11 @@ class TemperatureControl : public Module {
 
         float runaway_error_range;
 
+        // only created when model predictive control is configured or tuned
+        MPC_Controller *mpc;
+        float mpc_last_filament;
+        uint16_t mpc_fan_switch;
+
         enum RUNAWAY_TYPE {NOT_HEATING, HEATING_UP, COOLING_DOWN, TARGET_TEMPERATURE_REACHED};
 
         // pack these to save memory
@@ -88,6 +97,7 @@ class TemperatureControl : public Module {
             uint16_t runaway_timer:9;
             uint8_t tick:3;
             bool use_bangbang:1;
+            bool use_mpc:1;
             bool waiting:1;
             bool temp_violated:1;
             bool active:1;
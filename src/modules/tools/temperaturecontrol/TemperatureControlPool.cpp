@@ -13,10 +13,12 @@ using namespace std;
 #include "TemperatureControlPool.h"
 #include "TemperatureControl.h"
 #include "PID_Autotuner.h"
+#include "TemperatureTelemetry.h"
 #include "Config.h"
 #include "checksumm.h"
 #include "ConfigValue.h"
 #include "TemperatureControlPublicAccess.h"
+#include "platform_memory.h"
 
 #define enable_checksum              CHECKSUM("enable")
 
@@ -29,13 +31,17 @@ void TemperatureControlPool::load_tools()
         // If module is enabled
         if( THEKERNEL->config->value(temperature_control_checksum, cs, enable_checksum )->as_bool() ) {
             TemperatureControl *controller = new TemperatureControl(cs, cnt++);
-            THEKERNEL->add_module(controller);
+            THEKERNEL->add_module(controller, "temperature_control");
         }
     }
 
     // no need to create one of these if no heaters defined
     if(cnt > 0) {
         PID_Autotuner *pidtuner = new PID_Autotuner();
-        THEKERNEL->add_module( pidtuner );
+        THEKERNEL->add_module( pidtuner, "PID_Autotuner" );
+
+        // M155 auto reporting, mostly buffers so keep it out of main memory
+        TemperatureTelemetry *telemetry = new(AHB0) TemperatureTelemetry();
+        THEKERNEL->add_module( telemetry, "TemperatureTelemetry" );
     }
 }
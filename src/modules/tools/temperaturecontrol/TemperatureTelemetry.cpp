@@ -0,0 +1,225 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "TemperatureTelemetry.h"
+#include "Kernel.h"
+#include "Gcode.h"
+#include "Robot.h"
+#include "StreamOutput.h"
+#include "StreamOutputPool.h"
+
+#include "mbed.h" // for us_ticker_read()
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+// the fastest it will go, in practice it is limited to the rate each heater is read at
+#define MIN_INTERVAL 0.01F
+#define MAX_BATCH 16
+
+TemperatureTelemetry *TemperatureTelemetry::instance= nullptr;
+
+TemperatureTelemetry::TemperatureTelemetry()
+{
+    period_us= 0;
+    dropped= 0;
+    heaters_seen= 0;
+    stream= nullptr;
+    frame_mask= 0;
+    out_len= 0;
+    lines= 0;
+    batch= 1;
+    with_position= true;
+    for (int i = 0; i < max_heaters; ++i) {
+        designators[i]= "?";
+        last_sample_us[i]= 0;
+    }
+}
+
+void TemperatureTelemetry::on_module_loaded()
+{
+    instance= this;
+    register_for_event(ON_GCODE_RECEIVED);
+    register_for_event(ON_IDLE);
+}
+
+// called in the slow ticker so must be quick
+void TemperatureTelemetry::add_sample(uint8_t heater, const char *designator, float temperature, float target, int pwm)
+{
+    if(heater >= max_heaters) return;
+
+    uint32_t now= us_ticker_read();
+    uint32_t period= period_us;
+    if(now - last_sample_us[heater] < period) return;
+    // keep to the interval rather than slipping by up to a reading each time, unless we are well behind
+    last_sample_us[heater] += period;
+    if(now - last_sample_us[heater] >= period) last_sample_us[heater]= now;
+
+    designators[heater]= designator;
+    heaters_seen |= (1 << heater);
+
+    sample_t s;
+    s.us= now;
+    s.temperature= temperature;
+    s.target= (target <= 0) ? 0 : target;
+    s.heater= heater;
+    s.pwm= (pwm < 0) ? 0 : (pwm > 255) ? 255 : pwm;
+    if(!samples.push_back(s)) dropped= dropped + 1;
+}
+
+void TemperatureTelemetry::start(float interval, StreamOutput *stream, int batch, bool position)
+{
+    stop();
+
+    if(interval < MIN_INTERVAL) interval= MIN_INTERVAL;
+    if(batch < 1) batch= 1; else if(batch > MAX_BATCH) batch= MAX_BATCH;
+
+    this->stream= stream;
+    this->batch= batch;
+    this->with_position= position;
+    this->samples.flush();
+    this->frame_mask= 0;
+    this->out_len= 0;
+    this->lines= 0;
+    this->reported_dropped= this->dropped;
+
+    uint32_t period= interval * 1000000.0F;
+    uint32_t now= us_ticker_read();
+    this->last_us= now;
+    this->elapsed_us= 0;
+    // so every heater is sampled on its next reading
+    for (int i = 0; i < max_heaters; ++i) {
+        last_sample_us[i]= now - period;
+    }
+    this->period_us= period;
+}
+
+void TemperatureTelemetry::stop()
+{
+    if(stream == nullptr) return;
+    period_us= 0;
+    end_frame();
+    flush();
+    stream= nullptr;
+}
+
+// snprintf onto the end of buf, stopping quietly when it is full
+static void append(char *buf, size_t size, size_t &n, const char *format, ...)
+{
+    if(n + 1 >= size) return;
+    va_list args;
+    va_start(args, format);
+    int k= vsnprintf(buf + n, size - n, format, args);
+    va_end(args);
+    if(k > 0) n += ((size_t)k < size - n) ? k : size - n - 1;
+}
+
+// turn the samples gathered so far into a line and add it to the batch
+void TemperatureTelemetry::end_frame()
+{
+    if(frame_mask == 0) return;
+
+    // timestamps wrap every 71 minutes so keep our own count
+    elapsed_us += frame_us - last_us;
+    last_us= frame_us;
+
+    char line[320];
+    size_t n= 0;
+    append(line, sizeof(line) - 1, n, "AR:%lu", (unsigned long)(elapsed_us / 1000));
+    for (int i = 0; i < max_heaters; ++i) {
+        if(frame_mask & (1 << i)) {
+            append(line, sizeof(line) - 1, n, " %s:%1.2f /%1.2f @%u", designators[i], frame[i].temperature, frame[i].target, frame[i].pwm);
+        }
+    }
+    frame_mask= 0;
+
+    if(with_position) {
+        Robot *robot= THEKERNEL->robot;
+        float mpos[3];
+        robot->get_current_machine_position(mpos);
+        // current_position/mpos includes the compensation transform so we need to get the inverse to get actual position
+        if(robot->compensationTransform) robot->compensationTransform(mpos, true);
+        append(line, sizeof(line) - 1, n, " X:%1.4f Y:%1.4f Z:%1.4f", robot->from_millimeters(mpos[0]), robot->from_millimeters(mpos[1]), robot->from_millimeters(mpos[2]));
+    }
+
+    uint32_t d= dropped;
+    if(d != reported_dropped) {
+        append(line, sizeof(line) - 1, n, " dropped:%lu", (unsigned long)(d - reported_dropped));
+        reported_dropped= d;
+    }
+    line[n++]= '\n';
+
+    // leave room for the terminator
+    if(out_len + n >= sizeof(out)) {
+        flush();
+        if(stream == nullptr) return;
+    }
+    memcpy(out + out_len, line, n);
+    out_len += n;
+    ++lines;
+}
+
+void TemperatureTelemetry::flush()
+{
+    if(out_len > 0 && stream != nullptr) {
+        // the stream it was asked for on may have gone away, eg a telnet session was closed
+        if(stream != THEKERNEL->streams && !THEKERNEL->streams->has_stream(stream)) {
+            period_us= 0;
+            stream= nullptr;
+        } else {
+            out[out_len]= '\0';
+            stream->puts(out);
+        }
+    }
+    out_len= 0;
+    lines= 0;
+}
+
+void TemperatureTelemetry::on_idle(void *argument)
+{
+    if(stream == nullptr) return;
+
+    // a line gets one sample from each heater, a heater turning up again means one was missed so start a new line
+    sample_t s;
+    while(samples.pop_front(s)) {
+        uint8_t bit= 1 << s.heater;
+        if(frame_mask & bit) end_frame();
+        if(frame_mask == 0) frame_us= s.us;
+        frame[s.heater]= s;
+        frame_mask |= bit;
+        if(frame_mask == heaters_seen) end_frame();
+        if(stream == nullptr) return;
+    }
+
+    if(lines >= batch) flush();
+}
+
+void TemperatureTelemetry::on_gcode_received(void *argument)
+{
+    Gcode *gcode = static_cast<Gcode *>(argument);
+    if(!gcode->has_m || gcode->m != 155) return;
+
+    if(gcode->has_letter('S')) {
+        float interval= gcode->get_value('S');
+        if(interval <= 0) {
+            stop();
+            return;
+        }
+        // report to whoever asked, unless it is not a stream that stays around, eg a file being played
+        StreamOutput *s= THEKERNEL->streams->has_stream(gcode->stream) ? gcode->stream : THEKERNEL->streams;
+        int b= gcode->has_letter('B') ? gcode->get_int('B') : 1;
+        bool p= gcode->has_letter('P') ? gcode->get_int('P') != 0 : true;
+        start(interval, s, b, p);
+
+    } else if(stream == nullptr) {
+        gcode->stream->printf("Auto report is off\n");
+
+    } else {
+        gcode->stream->printf("Auto report every %1.3fs, %d lines at a time, %lu samples dropped\n", period_us / 1000000.0F, batch, (unsigned long)dropped);
+    }
+}
@@ -0,0 +1,80 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TEMPERATURETELEMETRY_H
+#define TEMPERATURETELEMETRY_H
+
+#include "Module.h"
+#include "RingBuffer.h"
+
+#include <stdint.h>
+
+class StreamOutput;
+
+// Auto reporting of the heaters so a host can plot them without polling with M105.
+// M155 S<seconds> turns it on for the stream it came from (S0 turns it off), B<n> sends n lines at a time and P0 leaves out the position.
+// Each heater drops a sample into a ring buffer from its reading tick when one is due, and the main loop gathers one sample from
+// each heater into a line, eg
+//   AR:12345 T:210.12 /210.00 @127 B:60.03 /60.00 @80 X:10.0000 Y:20.0000 Z:0.2000
+// where 12345 is milliseconds since reporting started, then each heater as M105 shows it and the machine
+// position when the line was made. If the main loop falls behind and samples are lost the next line ends with dropped:n.
+class TemperatureTelemetry : public Module
+{
+    public:
+        TemperatureTelemetry();
+
+        void on_module_loaded();
+        void on_gcode_received(void *argument);
+        void on_idle(void *argument);
+
+        // called from the reading tick of each heater
+        static void sample(uint8_t heater, const char *designator, float temperature, float target, int pwm)
+        {
+            if(instance != nullptr && instance->period_us != 0) instance->add_sample(heater, designator, temperature, target, pwm);
+        }
+
+    private:
+        static TemperatureTelemetry *instance;
+        static const int max_heaters= 8;
+
+        struct sample_t {
+            uint32_t us;
+            float temperature;
+            float target;
+            uint8_t heater;
+            uint8_t pwm;
+        };
+
+        void add_sample(uint8_t heater, const char *designator, float temperature, float target, int pwm);
+        void start(float interval, StreamOutput *stream, int batch, bool position);
+        void stop();
+        void end_frame();
+        void flush();
+
+        RingBuffer<sample_t, 64> samples;
+        const char *designators[max_heaters];
+        uint32_t last_sample_us[max_heaters];
+        volatile uint32_t period_us;
+        volatile uint32_t dropped;
+        volatile uint8_t heaters_seen;
+
+        // the line being put together and the batch of lines waiting to be sent, only touched in the main loop
+        StreamOutput *stream;
+        sample_t frame[max_heaters];
+        uint8_t frame_mask;
+        uint32_t frame_us;
+        uint32_t last_us;
+        uint64_t elapsed_us;
+        uint32_t reported_dropped;
+        char out[512];
+        uint16_t out_len;
+        uint8_t lines;
+        uint8_t batch;
+        bool with_position;
+};
+
+#endif
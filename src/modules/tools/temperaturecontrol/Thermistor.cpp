@@ -20,6 +20,7 @@
 #include "predefined_thermistors.h"
 
 #include <fastmath.h>
+#include <algorithm>
 
 #include "MRI_Hooks.h"
 
@@ -37,6 +38,11 @@
 #define rt_curve_checksum                  CHECKSUM("rt_curve")
 #define coefficients_checksum              CHECKSUM("coefficients")
 #define use_beta_table_checksum            CHECKSUM("use_beta_table")
+#define lookup_table_tolerance_checksum    CHECKSUM("lookup_table_tolerance")
+
+// the range of temperatures covered by the lookup table, readings outside it are calculated
+#define TABLE_MIN_TEMP 0.0F
+#define TABLE_MAX_TEMP 400.0F
 
 
 Thermistor::Thermistor()
@@ -47,6 +53,7 @@ Thermistor::Thermistor()
     min_temp= 999;
     max_temp= 0;
     this->thermistor_number= 0; // not a predefined thermistor
+    this->table_tolerance= 0;
 }
 
 Thermistor::~Thermistor()
@@ -66,6 +73,9 @@ void Thermistor::UpdateConfig(uint16_t module_checksum, uint16_t name_checksum)
     // force use of beta perdefined thermistor table based on betas
     bool use_beta_table= THEKERNEL->config->value(module_checksum, name_checksum, use_beta_table_checksum)->by_default(false)->as_bool();
 
+    // how far the lookup table may be from the calculated temperature in °C, 0 calculates every reading
+    this->table_tolerance= THEKERNEL->config->value(module_checksum, name_checksum, lookup_table_tolerance_checksum)->by_default(0.1F)->as_number();
+
     bool found= false;
     int cnt= 0;
     // load a predefined thermistor name if found
@@ -180,6 +190,7 @@ void Thermistor::UpdateConfig(uint16_t module_checksum, uint16_t name_checksum)
         return;
     }
 
+    build_table();
 }
 
 // print out predefined thermistors
@@ -251,25 +262,27 @@ void Thermistor::get_raw()
     }
 
     int adc_value= new_thermistor_reading();
-    const uint32_t max_adc_value= THEKERNEL->adc->get_max_value();
 
-     // resistance of the thermistor in ohms
-    float r = r2 / (((float)max_adc_value / adc_value) - 1.0F);
-    if (r1 > 0.0F) r = (r1 * r) / (r1 - r);
+    float r = adc_value_to_resistance(adc_value);
 
     THEKERNEL->streams->printf("adc= %d, resistance= %f\n", adc_value, r);
 
-    float t;
+    float t= resistance_to_temperature(r);
     if(this->use_steinhart_hart) {
         THEKERNEL->streams->printf("S/H c1= %1.18f, c2= %1.18f, c3= %1.18f\n", c1, c2, c3);
-        float l = logf(r);
-        t= (1.0F / (this->c1 + this->c2 * l + this->c3 * powf(l,3))) - 273.15F;
         THEKERNEL->streams->printf("S/H temp= %f, min= %f, max= %f, delta= %f\n", t, min_temp, max_temp, max_temp-min_temp);
     }else{
-        t= (1.0F / (k + (j * logf(r / r0)))) - 273.15F;
         THEKERNEL->streams->printf("beta temp= %f, min= %f, max= %f, delta= %f\n", t, min_temp, max_temp, max_temp-min_temp);
     }
 
+    if(table.empty()) {
+        THEKERNEL->streams->printf("lookup table not used\n");
+    }else{
+        float tt;
+        if(!table.lookup(adc_value, tt)) tt= t;
+        THEKERNEL->streams->printf("lookup table: %u points, max error= %1.3f, table temp= %f\n", table.size(), table.get_max_error(), tt);
+    }
+
     // if using a predefined thermistor show its name and which table it is from
     if(thermistor_number != 0) {
         string name= (thermistor_number&0x80) ? predefined_thermistors_beta[(thermistor_number&0x7F)-1].name :  predefined_thermistors[thermistor_number-1].name;
@@ -280,28 +293,62 @@ void Thermistor::get_raw()
     min_temp= max_temp= t;
 }
 
-float Thermistor::adc_value_to_temperature(uint32_t adc_value)
+// resistance of the thermistor in ohms
+float Thermistor::adc_value_to_resistance(uint32_t adc_value) const
 {
     const uint32_t max_adc_value= THEKERNEL->adc->get_max_value();
-    if ((adc_value >= max_adc_value) || (adc_value == 0))
-        return infinityf();
-
-    // resistance of the thermistor in ohms
     float r = r2 / (((float)max_adc_value / adc_value) - 1.0F);
     if (r1 > 0.0F) r = (r1 * r) / (r1 - r);
+    return r;
+}
 
-    if(r > this->r0 * 8) return infinityf(); // 800k is probably open circuit
-
-    float t;
+float Thermistor::resistance_to_temperature(float r) const
+{
     if(this->use_steinhart_hart) {
         float l = logf(r);
-        t= (1.0F / (this->c1 + this->c2 * l + this->c3 * powf(l,3))) - 273.15F;
+        return (1.0F / (this->c1 + this->c2 * l + this->c3 * powf(l,3))) - 273.15F;
     }else{
         // use Beta value
-        t= (1.0F / (k + (j * logf(r / r0)))) - 273.15F;
+        return (1.0F / (k + (j * logf(r / r0)))) - 273.15F;
     }
+}
 
-    return t;
+// tabulate the normal range of readings, up to the point where the thermistor would be taken as open circuit
+void Thermistor::build_table()
+{
+    table.clear();
+    if(bad_config || table_tolerance <= 0) return;
+
+    float min_temp= std::max(TABLE_MIN_TEMP, resistance_to_temperature(this->r0 * 8));
+    table.build([this](uint32_t adc) { return resistance_to_temperature(adc_value_to_resistance(adc)); },
+                THEKERNEL->adc->get_max_value(), min_temp, TABLE_MAX_TEMP, table_tolerance);
+}
+
+// the table a thermistor with the given Steinhart-Hart coefficients would get with the usual 4k7 pullup and no parallel resistor
+bool Thermistor::build_steinhart_hart_table(ThermistorTable& table, float c1, float c2, float c3, float tolerance)
+{
+    const uint32_t max_adc_value= THEKERNEL->adc->get_max_value();
+    auto temperature= [=](uint32_t adc) {
+        float r = 4700 / (((float)max_adc_value / adc) - 1.0F);
+        float l = logf(r);
+        return (1.0F / (c1 + c2 * l + c3 * powf(l,3))) - 273.15F;
+    };
+    return table.build(temperature, max_adc_value, TABLE_MIN_TEMP, TABLE_MAX_TEMP, tolerance);
+}
+
+float Thermistor::adc_value_to_temperature(uint32_t adc_value)
+{
+    const uint32_t max_adc_value= THEKERNEL->adc->get_max_value();
+    if ((adc_value >= max_adc_value) || (adc_value == 0))
+        return infinityf();
+
+    float t;
+    if(table.lookup(adc_value, t)) return t;
+
+    float r = adc_value_to_resistance(adc_value);
+    if(r > this->r0 * 8) return infinityf(); // 800k is probably open circuit
+
+    return resistance_to_temperature(r);
 }
 
 int Thermistor::new_thermistor_reading()
@@ -352,6 +399,7 @@ bool Thermistor::set_optional(const sensor_options_t& options) {
             calc_jk();
             thermistor_number= predefined;
             this->bad_config= false;
+            build_table();
             return true;
 
         }else {
@@ -370,6 +418,7 @@ bool Thermistor::set_optional(const sensor_options_t& options) {
             use_steinhart_hart= true;
             thermistor_number= predefined;
             this->bad_config= false;
+            build_table();
             return true;
         }
     }
@@ -396,6 +445,7 @@ bool Thermistor::set_optional(const sensor_options_t& options) {
     }
 
     if(this->bad_config) this->bad_config= false;
+    build_table();
 
     return true;
 }
@@ -11,6 +11,7 @@
 #include "TempSensor.h"
 #include "RingBuffer.h"
 #include "Pin.h"
+#include "ThermistorTable.h"
 
 #include <tuple>
 
@@ -32,11 +33,15 @@ class Thermistor : public TempSensor
         void get_raw();
         static std::tuple<float,float,float> calculate_steinhart_hart_coefficients(float t1, float r1, float t2, float r2, float t3, float r3);
         static void print_predefined_thermistors(StreamOutput*);
+        static bool build_steinhart_hart_table(ThermistorTable& table, float c1, float c2, float c3, float tolerance);
 
     private:
         int new_thermistor_reading();
         float adc_value_to_temperature(uint32_t adc_value);
+        float resistance_to_temperature(float r) const;
+        float adc_value_to_resistance(uint32_t adc_value) const;
         void calc_jk();
+        void build_table();
 
         // Thermistor computation settings using beta, not used if using Steinhart-Hart
         float r0;
@@ -62,6 +67,10 @@ class Thermistor : public TempSensor
 
         Pin  thermistor_pin;
 
+        // readings in the normal range are looked up rather than calculated
+        ThermistorTable table;
+        float table_tolerance;
+
         float min_temp, max_temp;
         struct {
             bool bad_config:1;
@@ -0,0 +1,197 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ThermistorTable.h"
+
+#include <algorithm>
+#include <math.h>
+
+ThermistorTable::ThermistorTable()
+{
+    points= nullptr;
+    n= 0;
+    max_error= 0;
+}
+
+ThermistorTable::~ThermistorTable()
+{
+    clear();
+}
+
+void ThermistorTable::clear()
+{
+    delete [] points;
+    points= nullptr;
+    n= 0;
+    max_error= 0;
+}
+
+static int16_t quantize(float t, int scale)
+{
+    return lroundf(t * scale);
+}
+
+// the largest difference between the straight line from a to b and the exact curve.
+// Checked at a few points along the segment, then if refine is set the biggest of those is homed in on by bisecting
+// for where the error stops growing, which is a few dozen readings rather than one for every ADC value
+float ThermistorTable::segment_error(std::function<float(uint32_t)>& temperature, const point_t& a, uint32_t b, float tb, bool refine) const
+{
+    float ta= (float)a.temp / scale;
+    uint32_t len= b - a.adc;
+    auto error= [&](uint32_t adc) {
+        float line= ta + (tb - ta) * (adc - a.adc) / len;
+        return fabsf(line - temperature(adc));
+    };
+
+    float err= 0;
+    int peak= 0;
+    for (int i = 1; i < 8; ++i) {
+        uint32_t adc= a.adc + (len * i) / 8;
+        if(adc == a.adc) continue;
+        float e= error(adc);
+        if(!(e <= err)) { // NaN counts as too big
+            err= e;
+            peak= i;
+        }
+    }
+    if(!refine || peak == 0 || isnan(err)) return err;
+
+    // the curve bends one way either side of the sample with the biggest error, so the error rises to one peak
+    // between the samples next to it, though there may be a smaller one of the other sign where the curve inflects
+    uint32_t l= a.adc + (len * (peak - 1)) / 8, h= a.adc + (len * (peak + 1)) / 8;
+    while(h - l > 2) {
+        uint32_t m= (l + h) / 2;
+        if(error(m + 1) > error(m)) l= m; else h= m + 1;
+    }
+    for (uint32_t adc = l; adc <= h; ++adc) {
+        if(adc == a.adc || adc == b) continue;
+        float e= error(adc);
+        if(!(e <= err)) err= e;
+    }
+    return err;
+}
+
+bool ThermistorTable::build(std::function<float(uint32_t)> temperature, uint32_t max_adc, float min_temp, float max_temp, float tolerance)
+{
+    clear();
+    if(max_adc < 4 || max_temp * scale >= INT16_MAX || min_temp * scale <= INT16_MIN) return false;
+
+    // lookup() rounds to the nearest 1/scale °C, so the segments get the rest of the tolerance
+    const float budget= tolerance - 0.5F / scale;
+    if(budget <= 0) return false;
+
+    // the readings at the ends are open or shorted sensors, and tell us which way the curve goes
+    bool falling= temperature(1) > temperature(max_adc - 1);
+
+    // first reading in [1, max_adc) for which pred holds, pred must go from false to true once over the range
+    auto first= [&](std::function<bool(float)> pred) {
+        uint32_t l= 1, h= max_adc;
+        while(l < h) {
+            uint32_t m= (l + h) / 2;
+            if(pred(temperature(m))) h= m; else l= m + 1;
+        }
+        return l;
+    };
+
+    uint32_t lo, hi;
+    if(falling) {
+        lo= first([&](float t) { return t <= max_temp; });
+        hi= first([&](float t) { return t < min_temp; }) - 1;
+    }else{
+        lo= first([&](float t) { return t >= min_temp; });
+        hi= first([&](float t) { return t > max_temp; }) - 1;
+    }
+    if(lo >= hi || hi >= max_adc) return false;
+
+    point_t table[max_points];
+    table[0].adc= lo;
+    table[0].temp= quantize(temperature(lo), scale);
+    size_t cnt= 1;
+    float worst= 0;
+
+    // make each segment about as long as the tolerance allows. Neighbouring segments are about the same length, so start
+    // from the last one, double or halve to find one end that fits and one that does not, then bisect between them
+    uint32_t s= lo, len= 16;
+    while(s < hi && cnt < max_points) {
+        const point_t& a= table[cnt - 1];
+        auto fits= [&](uint32_t e, bool refine) {
+            return segment_error(temperature, a, e, (float)quantize(temperature(e), scale) / scale, refine) <= budget;
+        };
+
+        uint32_t good= s + 1, bad= 0;
+        uint32_t e= std::min(s + len, hi);
+        if(fits(e, false)) {
+            good= e;
+            while(good < hi) {
+                e= std::min(s + (good - s) * 2, hi);
+                if(!fits(e, false)) { bad= e; break; }
+                good= e;
+            }
+        }else{
+            bad= e;
+            while(bad - s > 1) {
+                e= s + (bad - s) / 2;
+                if(fits(e, false)) { good= e; break; }
+                bad= e;
+            }
+        }
+
+        // a segment a few percent short of the longest possible costs nothing, so stop bisecting there
+        if(bad != 0) {
+            while(bad - good > 1 && bad - good > (good - s) / 32) {
+                uint32_t m= (good + bad) / 2;
+                if(fits(m, false)) good= m; else bad= m;
+            }
+        }
+
+        // the samples can miss the peak by a little, so check it properly and back off until it fits
+        float err;
+        while((err= segment_error(temperature, a, good, (float)quantize(temperature(good), scale) / scale, true)) > budget && good - s > 1) {
+            good= s + std::max<uint32_t>(1, (good - s) * 15 / 16);
+        }
+        if(err > worst) worst= err;
+
+        table[cnt].adc= good;
+        table[cnt].temp= quantize(temperature(good), scale);
+        ++cnt;
+        len= good - s;
+        s= good;
+    }
+
+    // if we ran out of points the rest of the range is just not covered
+    this->points= new point_t[cnt];
+    for (size_t i = 0; i < cnt; ++i) {
+        this->points[i]= table[i];
+    }
+    this->n= cnt;
+
+    // the worst segment plus the rounding in lookup()
+    this->max_error= worst + 0.5F / scale;
+
+    return true;
+}
+
+bool ThermistorTable::lookup(uint32_t adc, float& t) const
+{
+    if(n < 2 || adc < points[0].adc || adc > points[n - 1].adc) return false;
+
+    // find the segment holding adc
+    size_t l= 0, h= n - 1;
+    while(h - l > 1) {
+        size_t m= (l + h) / 2;
+        if(points[m].adc <= adc) l= m; else h= m;
+    }
+
+    const point_t& a= points[l];
+    const point_t& b= points[h];
+    int32_t dt= (int32_t)(b.temp - a.temp) * (int32_t)(adc - a.adc);
+    int32_t da= b.adc - a.adc;
+    // round to nearest rather than towards zero
+    dt += (dt < 0) ? -da / 2 : da / 2;
+    t= (float)(a.temp + dt / da) / scale;
+    return true;
+}
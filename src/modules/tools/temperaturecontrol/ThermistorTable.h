@@ -0,0 +1,55 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef THERMISTORTABLE_H
+#define THERMISTORTABLE_H
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+
+// A piecewise linear approximation of a thermistor's ADC reading to temperature curve, so a reading costs a binary search
+// and an integer interpolation instead of a logf in software floating point.
+// The breakpoints are placed so each segment, with the rounding of the result, stays within the requested tolerance of the exact curve, so they bunch up
+// where the curve bends at the hot end and spread out where it is nearly straight.
+// Only the readings between max_temp and min_temp are covered, lookup() returns false outside that and the caller
+// falls back to the exact calculation, which also catches open and shorted sensors.
+class ThermistorTable
+{
+    public:
+        ThermistorTable();
+        ~ThermistorTable();
+
+        // temperature must be monotonic in the ADC reading over the range
+        bool build(std::function<float(uint32_t)> temperature, uint32_t max_adc, float min_temp, float max_temp, float tolerance);
+        void clear();
+        bool lookup(uint32_t adc, float& t) const;
+
+        size_t size() const { return n; }
+        bool empty() const { return n == 0; }
+        // the largest difference from the exact curve found when the table was built, in °C, including the rounding of lookup()
+        float get_max_error() const { return max_error; }
+
+    private:
+        // temperatures are held in 1/32 °C so a point fits in a word
+        static const int scale= 32;
+        static const size_t max_points= 64;
+
+        struct point_t {
+            uint16_t adc;
+            int16_t temp;
+        };
+
+        uint32_t find_adc(std::function<float(uint32_t)>& temperature, uint32_t lo, uint32_t hi, float t) const;
+        float segment_error(std::function<float(uint32_t)>& temperature, const point_t& a, uint32_t b, float tb, bool refine) const;
+
+        point_t *points;
+        float max_error;
+        uint8_t n;
+};
+
+#endif
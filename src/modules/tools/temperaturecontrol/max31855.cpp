@@ -14,6 +14,8 @@
 
 #include "max31855.h"
 
+#include "cmsis.h" // mbed.h lib
+
 #include "MRI_Hooks.h"
 
 #define chip_select_checksum CHECKSUM("chip_select_pin")
@@ -22,12 +24,12 @@
 Max31855::Max31855() :
     spi(nullptr)
 {
-    this->read_flag=true;
 }
 
 Max31855::~Max31855()
 {
-    delete spi;
+    // the queue still has hold of it
+    while(spi != nullptr && transaction.is_pending()) spi->poll();
 }
 
 // Get configuration from the config file
@@ -38,59 +40,53 @@ void Max31855::UpdateConfig(uint16_t module_checksum, uint16_t name_checksum)
     this->spi_cs_pin.set(true);
     this->spi_cs_pin.as_output();
 
-    // select which SPI channel to use
+    // select which SPI channel to use, 0 or 1
     int spi_channel = THEKERNEL->config->value(module_checksum, name_checksum, spi_channel_checksum)->by_default(0)->as_number();
-    PinName miso;
-    PinName mosi;
-    PinName sclk;
-    if(spi_channel == 0) {
-        // Channel 0
-        mosi=P0_18; miso=P0_17; sclk=P0_15;
-    } else {
-        // Channel 1
-        mosi=P0_9; miso=P0_8; sclk=P0_7;
-    }
-
-    delete spi;
-    spi = new mbed::SPI(mosi, miso, sclk);
-
-    // Spi settings: 1MHz (default), 16 bits, mode 0 (default)
-    spi->format(16);
+    spi = SPIQueue::channel(spi_channel == 0 ? 0 : 1);
+
+    // Spi settings: 1MHz, 16 bits, mode 0, just reading
+    transaction.cs = &this->spi_cs_pin;
+    transaction.rx = &this->data;
+    transaction.n = 1;
+    transaction.bits = 16;
+    transaction.mode = 0;
+    transaction.frequency = 1000000;
 }
 
 // returns an average of the last few temperature values we've read
+// called from the temperature tick, picks up the reading asked for last time and asks for the next one, the queue does
+// the actual transfer so nothing waits on the bus here
 float Max31855::get_temperature()
 {
-    // allow read from hardware via SPI on next call to on_idle()
-    this->read_flag=true;
+    if(spi != nullptr) {
+        // this is now and then called from the main loop as well, so keep the tick out while the reading is picked up
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        if(transaction.is_done()) add_reading(this->data);
+        spi->submit(&transaction);
+        if(primask == 0) __enable_irq();
+    }
 
     // Return an average of the last readings
     if(readings.size()==0) return infinityf();
 
     float sum = 0;
-    for (int i=0; i<readings.size(); i++) {
-        sum += *readings.get_ref(i);
+    for (size_t i=0; i<readings.size(); i++) {
+        sum += readings.peek(i);
     }
 
     return sum / readings.size();
 }
 
-// ask the temperature sensor hardware for a value, store it in a buffer
+// when the channel is shared with something that is not on the queue the transfer is run from here instead
 void Max31855::on_idle()
 {
-    // this rate limits SPI access
-    if(!this->read_flag) return;
-
-    this->spi_cs_pin.set(false);
-    wait_us(1); // Must wait for first bit valid
-
-    // Read 16 bits (writing something as well is required by the api)
-    uint16_t data = spi->write(0);
-    //  Read next 16 bits (diagnostics)
-    //	uint16_t data2 = spi->write(0);
-
-    this->spi_cs_pin.set(true);
+    if(spi != nullptr) spi->poll();
+}
 
+// turn what the sensor sent into a temperature and store it in the buffer
+void Max31855::add_reading(uint16_t data)
+{
     float temperature;
 
     //Process temp
@@ -98,7 +94,7 @@ void Max31855::on_idle()
     {
         // Error flag.
         temperature = infinityf();
-        // Todo: Interpret data2 for more diagnostics.
+        // Todo: Read the next 16 bits for more diagnostics.
     }
     else
     {
@@ -113,7 +109,7 @@ void Max31855::on_idle()
     }
 
     if (readings.size() >= readings.capacity()) {
-        readings.delete_tail();
+        readings.discard();
     }
 
     // Discard occasional errors...
@@ -121,7 +117,4 @@ void Max31855::on_idle()
     {
         readings.push_back(temperature);
     }
-
-    // don't read again until get_temperature() is called
-    this->read_flag=false;
 }
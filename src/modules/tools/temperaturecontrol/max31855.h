@@ -11,8 +11,8 @@
 #include "TempSensor.h"
 #include <string>
 #include <libs/Pin.h>
-#include <mbed.h>
 #include "RingBuffer.h"
+#include "SPIQueue.h"
 
 class Max31855 : public TempSensor
 {
@@ -24,9 +24,12 @@ public:
     void on_idle();
 
 private:
-    struct { bool read_flag:1; } ; //when true, the next call to on_idle will read a new temperature value
+    void add_reading(uint16_t data);
+
     Pin spi_cs_pin;
-    mbed::SPI *spi;
+    SPIQueue *spi;
+    SPITransaction transaction;
+    uint16_t data;
     RingBuffer<float,16> readings;
 };
 
@@ -6,6 +6,8 @@
     -------
     Probes grid_size points in X and Y (total probes grid_size * grid_size) and stores the relative offsets from the 0,0 Z height
     When enabled every move will calculate the Z offset based on interpolating the height offset within the grids nearest 4 points.
+    Optionally a bicubic surface through the nearest 16 points is used instead, which follows a warped bed much more closely
+    between the points so fewer are needed.
 
     Configuration
     -------------
@@ -54,6 +56,15 @@
         "Two corners"" is not absolutely the correct name for this mode, because it uses only one corner and rectangle size.
         It can be turned off with G32 R0 and turned on with G32 R1.
 
+    The interpolation between the grid points is bilinear by default, it can be made bicubic with
+       leveling-strategy.rectangular-grid.interpolation  bicubic
+    this needs 64 bytes per grid cell more memory, if there is not enough it stays bilinear.
+    The grid and this are kept in AHB RAM.
+
+    With mm_max_compensation_error set lines are only cut into segments where they cross the grid and, within a cell, where
+    the surface bends away from a straight line by more than that, rather than every mm_per_line_segment.
+    With height_limit and dampening_start set, moves that change Z are still cut every mm_per_line_segment.
+
     Display mode of current grid can be changed to human readable mode (table with coordinates) by using
        leveling-strategy.rectangular-grid.human_readable  true
 
@@ -125,6 +136,7 @@
 #define dampening_start_checksum     CHECKSUM("dampening_start")
 #define before_probe_gcode_checksum  CHECKSUM("before_probe_gcode")
 #define after_probe_gcode_checksum   CHECKSUM("after_probe_gcode")
+#define interpolation_checksum       CHECKSUM("interpolation")
 
 #define GRIDFILE "/sd/cartesian.grid"
 #define GRIDFILE_NM "/sd/cartesian_nm.grid"
@@ -132,11 +144,28 @@
 CartGridStrategy::CartGridStrategy(ZProbe *zprobe) : LevelingStrategy(zprobe)
 {
     grid = nullptr;
+    bicubic = nullptr;
+    bicubic_size = 0;
 }
 
 CartGridStrategy::~CartGridStrategy()
 {
-    if(grid != nullptr) AHB0.dealloc(grid);
+    if(grid != nullptr) ahb_dealloc(grid);
+    if(bicubic != nullptr) ahb_dealloc(bicubic);
+}
+
+// the grid can be bigger than the blocks the main heap can spare, so it goes in whichever AHB bank has room
+void *CartGridStrategy::ahb_alloc(size_t n)
+{
+    void *p= AHB0.alloc(n);
+    if(p == nullptr) p= AHB1.alloc(n);
+    return p;
+}
+
+void CartGridStrategy::ahb_dealloc(void *p)
+{
+    if(AHB0.has(p)) AHB0.dealloc(p);
+    else AHB1.dealloc(p);
 }
 
 bool CartGridStrategy::handleConfig()
@@ -214,14 +243,25 @@ bool CartGridStrategy::handleConfig()
     std::replace(before_probe.begin(), before_probe.end(), '_', ' '); // replace _ with space
     std::replace(after_probe.begin(), after_probe.end(), '_', ' '); // replace _ with space
 
-    // allocate in AHB0
-    grid = (float *)AHB0.alloc(configured_grid_x_size * configured_grid_y_size * sizeof(float));
+    // allocate in AHB0 or AHB1
+    grid = (float *)ahb_alloc(configured_grid_x_size * configured_grid_y_size * sizeof(float));
 
     if(grid == nullptr) {
         THEKERNEL->streams->printf("Error: Not enough memory\n");
         return false;
     }
 
+    // the coefficients of every cell, enough for any grid G31 I J can probe, which has at most (sqrt(points) - 1)^2 cells
+    std::string interpolation = THEKERNEL->config->value(leveling_strategy_checksum, cart_grid_leveling_strategy_checksum, interpolation_checksum)->by_default("bilinear")->as_string();
+    if(interpolation == "bicubic") {
+        float side = sqrtf(configured_grid_x_size * configured_grid_y_size) - 1;
+        bicubic_size = (size_t)(side * side + 0.001F) * 16;
+        bicubic = (float *)ahb_alloc(bicubic_size * sizeof(float));
+        if(bicubic == nullptr) {
+            THEKERNEL->streams->printf("Warning: Not enough memory for bicubic interpolation, using bilinear\n");
+        }
+    }
+
     reset_bed_level();
 
     return true;
@@ -491,10 +531,19 @@ void CartGridStrategy::setAdjustFunction(bool on)
         // set the compensationTransform in robot
         using std::placeholders::_1;
         using std::placeholders::_2;
+        using std::placeholders::_3;
+        using std::placeholders::_4;
+        using std::placeholders::_5;
+        float *coeffs = nullptr;
+        if(bicubic != nullptr && GridInterpolator::bicubic_size(current_grid_x_size, current_grid_y_size) <= bicubic_size) coeffs = bicubic;
+        interpolator.set_grid(grid, current_grid_x_size, current_grid_y_size, x_start, y_start, x_size / (current_grid_x_size - 1), y_size / (current_grid_y_size - 1), coeffs);
         THEROBOT->compensationTransform = std::bind(&CartGridStrategy::doCompensation, this, _1, _2); // [this](float *target, bool inverse) { doCompensation(target, inverse); };
+        THEROBOT->compensationSplits = std::bind(&CartGridStrategy::splitCompensation, this, _1, _2, _3, _4, _5);
     } else {
         // clear it
         THEROBOT->compensationTransform = nullptr;
+        THEROBOT->compensationSplits = nullptr;
+        interpolator.clear();
     }
 }
 
@@ -705,6 +754,19 @@ bool CartGridStrategy::doProbe(Gcode *gc)
     return true;
 }
 
+// where Robot has to break a line for doCompensation to stay within tolerance, -1 to leave it to mm_per_line_segment
+int CartGridStrategy::splitCompensation(const float *from, const float *to, float tolerance, float *t, int max)
+{
+    if (!isnan(this->damping_interval)) {
+        // no compensation at all up there
+        if(from[Z_AXIS] > this->height_limit && to[Z_AXIS] > this->height_limit) return 0;
+        // the damping ramps the offset with Z, which the grid does not know about
+        if(from[Z_AXIS] != to[Z_AXIS]) return -1;
+    }
+
+    return interpolator.split_line(from[X_AXIS], from[Y_AXIS], to[X_AXIS], to[Y_AXIS], tolerance, t, max);
+}
+
 void CartGridStrategy::doCompensation(float *target, bool inverse)
 {
     // Adjust print surface height by linear interpolation over the bed_level array.
@@ -722,31 +784,9 @@ void CartGridStrategy::doCompensation(float *target, bool inverse)
         }
     }
 
-    // find min/maxes, and handle the case where size is negative (assuming this is possible? Legacy code supported this)
-    float min_x = std::min(this->x_start, this->x_start + this->x_size);
-    float max_x = std::max(this->x_start, this->x_start + this->x_size);
-    float min_y = std::min(this->y_start, this->y_start + this->y_size);
-    float max_y = std::max(this->y_start, this->y_start + this->y_size);
-
-    // clamp the input to the bounds of the compensation grid
-    // if a point is beyond the bounds of the grid, it will get the offset of the closest grid point
-    float x_target = std::min(std::max(target[X_AXIS], min_x), max_x);
-    float y_target = std::min(std::max(target[Y_AXIS], min_y), max_y);
-
-    // we need to make sure that floor_x and floor_y are always < grid_size-1
-    float grid_x = std::max(0.001F, std::min(this->current_grid_x_size - 1.001F, (x_target - this->x_start) / (this->x_size / (this->current_grid_x_size - 1))));
-    float grid_y = std::max(0.001F, std::min(this->current_grid_x_size - 1.001F, (y_target - this->y_start) / (this->y_size / (this->current_grid_y_size - 1))));
-    int floor_x = floorf(grid_x);
-    int floor_y = floorf(grid_y);
-    float ratio_x = grid_x - floor_x;
-    float ratio_y = grid_y - floor_y;
-    float z1 = grid[(floor_x) + ((floor_y) * this->current_grid_x_size)];
-    float z2 = grid[(floor_x) + ((floor_y + 1) * this->current_grid_x_size)];
-    float z3 = grid[(floor_x + 1) + ((floor_y) * this->current_grid_x_size)];
-    float z4 = grid[(floor_x + 1) + ((floor_y + 1) * this->current_grid_x_size)];
-    float left = (1 - ratio_y) * z1 + ratio_y * z2;
-    float right = (1 - ratio_y) * z3 + ratio_y * z4;
-    float offset = (1 - ratio_x) * left + ratio_x * right;
+    // the grid geometry is worked out when it is set, and points in the same cell as the last one reuse its coefficients
+    // a point beyond the bounds of the grid gets the offset of the closest point on its edge
+    float offset = interpolator.get_offset(target[X_AXIS], target[Y_AXIS]);
 
     // handle case where the grid was incomplete (should never happen)
     if(isnan(offset)) return;
@@ -759,18 +799,6 @@ void CartGridStrategy::doCompensation(float *target, bool inverse)
 
 #if 0
     THEKERNEL->streams->printf("//DEBUG: TARGET: %f, %f, %f\n", target[0], target[1], target[2]);
-    THEKERNEL->streams->printf("//DEBUG: grid_x= %f\n", grid_x);
-    THEKERNEL->streams->printf("//DEBUG: grid_y= %f\n", grid_y);
-    THEKERNEL->streams->printf("//DEBUG: floor_x= %d\n", floor_x);
-    THEKERNEL->streams->printf("//DEBUG: floor_y= %d\n", floor_y);
-    THEKERNEL->streams->printf("//DEBUG: ratio_x= %f\n", ratio_x);
-    THEKERNEL->streams->printf("//DEBUG: ratio_y= %f\n", ratio_y);
-    THEKERNEL->streams->printf("//DEBUG: z1= %f\n", z1);
-    THEKERNEL->streams->printf("//DEBUG: z2= %f\n", z2);
-    THEKERNEL->streams->printf("//DEBUG: z3= %f\n", z3);
-    THEKERNEL->streams->printf("//DEBUG: z4= %f\n", z4);
-    THEKERNEL->streams->printf("//DEBUG: left= %f\n", left);
-    THEKERNEL->streams->printf("//DEBUG: right= %f\n", right);
     THEKERNEL->streams->printf("//DEBUG: offset= %f\n", offset);
     THEKERNEL->streams->printf("//DEBUG: scale= %f\n", scale);
     THEKERNEL->streams->printf("//DEBUG: adjustment= %f\n", offset*scale);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "LevelingStrategy.h"
+#include "GridInterpolator.h"
 
 #include <string.h>
 #include <tuple>
@@ -26,9 +27,12 @@ private:
     void setAdjustFunction(bool on);
     void print_bed_level(StreamOutput *stream);
     void doCompensation(float *target, bool inverse);
+    int splitCompensation(const float *from, const float *to, float tolerance, float *t, int max);
     void reset_bed_level();
     void save_grid(StreamOutput *stream);
     bool load_grid(StreamOutput *stream);
+    static void *ahb_alloc(size_t n);
+    static void ahb_dealloc(void *p);
 
     float initial_height;
     float tolerance;
@@ -39,6 +43,9 @@ private:
     std::string before_probe, after_probe;
 
     float *grid;
+    GridInterpolator interpolator;
+    float *bicubic;
+    size_t bicubic_size;
     std::tuple<float, float, float> probe_offsets;
     float *m_attach;
     float x_start,y_start;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "LevelingStrategy.h"
+#include "GridInterpolator.h"
 
 #include <string.h>
 #include <tuple>
@@ -37,6 +38,7 @@ private:
     float tolerance;
 
     float *grid;
+    GridInterpolator interpolator;
     float grid_radius;
     std::tuple<float, float, float> probe_offsets;
     uint8_t grid_size;
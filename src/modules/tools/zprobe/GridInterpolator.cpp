@@ -0,0 +1,235 @@
+#include "GridInterpolator.h"
+
+#include <math.h>
+#include <algorithm>
+
+GridInterpolator::GridInterpolator()
+{
+    clear();
+}
+
+void GridInterpolator::clear()
+{
+    grid= nullptr;
+    coeffs= nullptr;
+    nx= ny= 0;
+    cell_x= cell_y= -1;
+}
+
+void GridInterpolator::set_grid(const float *grid, uint8_t nx, uint8_t ny, float x0, float y0, float dx, float dy, float *bicubic)
+{
+    if(grid == nullptr || nx < 2 || ny < 2 || dx == 0 || dy == 0) {
+        clear();
+        return;
+    }
+
+    this->grid= grid;
+    this->nx= nx;
+    this->ny= ny;
+    this->x0= x0;
+    this->y0= y0;
+    this->inv_dx= 1.0F / dx;
+    this->inv_dy= 1.0F / dy;
+    this->max_gx= nx - 1.001F;
+    this->max_gy= ny - 1.001F;
+    // the heights may have changed under the cached cell
+    this->cell_x= this->cell_y= -1;
+
+    this->coeffs= bicubic;
+    if(bicubic != nullptr) {
+        for (int cy = 0; cy < ny - 1; ++cy) {
+            for (int cx = 0; cx < nx - 1; ++cx) {
+                fit_cell(cx, cy, &bicubic[(cx + cy * (nx - 1)) * 16]);
+            }
+        }
+    }
+}
+
+// the grid extended by a point on every side, in a straight line from the edge so the edge cells bend no more than the
+// points say and a tilted plane stays flat
+float GridInterpolator::point(int x, int y) const
+{
+    if(x < 0) return 2 * point(0, y) - point(1, y);
+    if(x >= nx) return 2 * point(nx - 1, y) - point(nx - 2, y);
+    if(y < 0) return 2 * point(x, 0) - point(x, 1);
+    if(y >= ny) return 2 * point(x, ny - 1) - point(x, ny - 2);
+    return grid[x + y * nx];
+}
+
+// c[i * 4 + j] multiplies rx^i * ry^j, which is M * P * M' for the 4x4 points P around the cell and the Catmull-Rom basis M
+void GridInterpolator::fit_cell(int cx, int cy, float *c) const
+{
+    static const float m[4][4]= {
+        {  0.0F,  1.0F,  0.0F,  0.0F },
+        { -0.5F,  0.0F,  0.5F,  0.0F },
+        {  1.0F, -2.5F,  2.0F, -0.5F },
+        { -0.5F,  1.5F, -1.5F,  0.5F }
+    };
+
+    float p[4][4];
+    for (int a = 0; a < 4; ++a) {
+        for (int b = 0; b < 4; ++b) {
+            p[a][b]= point(cx - 1 + a, cy - 1 + b);
+        }
+    }
+
+    float t[4][4];
+    for (int i = 0; i < 4; ++i) {
+        for (int b = 0; b < 4; ++b) {
+            t[i][b]= m[i][0] * p[0][b] + m[i][1] * p[1][b] + m[i][2] * p[2][b] + m[i][3] * p[3][b];
+        }
+    }
+
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            c[i * 4 + j]= t[i][0] * m[j][0] + t[i][1] * m[j][1] + t[i][2] * m[j][2] + t[i][3] * m[j][3];
+        }
+    }
+}
+
+void GridInterpolator::load_cell(int cx, int cy)
+{
+    cell_x= cx;
+    cell_y= cy;
+    if(coeffs != nullptr) {
+        cell= &coeffs[(cx + cy * (nx - 1)) * 16];
+        return;
+    }
+
+    const float *p= &grid[cx + cy * nx];
+    float z1= p[0];      // cx, cy
+    float z3= p[1];      // cx + 1, cy
+    float z2= p[nx];     // cx, cy + 1
+    float z4= p[nx + 1]; // cx + 1, cy + 1
+    c0= z1;
+    c1= z3 - z1;
+    c2= z2 - z1;
+    c3= z4 - z3 - z2 + z1;
+}
+
+// clamping to just inside the grid also puts points off it onto the nearest edge
+inline void GridInterpolator::grid_point(float x, float y, float& gx, float& gy) const
+{
+    gx= (x - x0) * inv_dx;
+    gy= (y - y0) * inv_dy;
+    if(!(gx > 0.001F)) gx= 0.001F; else if(gx > max_gx) gx= max_gx;
+    if(!(gy > 0.001F)) gy= 0.001F; else if(gy > max_gy) gy= max_gy;
+}
+
+float GridInterpolator::get_offset(float x, float y)
+{
+    float gx, gy;
+    grid_point(x, y, gx, gy);
+
+    // both are positive so this is floor
+    int cx= gx;
+    int cy= gy;
+    if(cx != cell_x || cy != cell_y) load_cell(cx, cy);
+
+    float rx= gx - cx;
+    float ry= gy - cy;
+    if(coeffs != nullptr) {
+        const float *c= cell;
+        float a0= c[0] + (c[1] + (c[2] + c[3] * ry) * ry) * ry;
+        float a1= c[4] + (c[5] + (c[6] + c[7] * ry) * ry) * ry;
+        float a2= c[8] + (c[9] + (c[10] + c[11] * ry) * ry) * ry;
+        float a3= c[12] + (c[13] + (c[14] + c[15] * ry) * ry) * ry;
+        return a0 + (a1 + (a2 + a3 * rx) * rx) * rx;
+    }
+    return c0 + c1 * rx + (c2 + c3 * rx) * ry;
+}
+
+// the fractions along a line from grid coordinate ga to gb where it crosses the grid lines 0 to n - 1, in order
+int GridInterpolator::crossings(float ga, float gb, int n, float *t, int max)
+{
+    if(ga == gb) return 0;
+    int count= 0;
+    float inv= 1.0F / (gb - ga);
+    if(gb > ga) {
+        for (int k = std::max(0, (int)floorf(ga) + 1); k <= n - 1 && k < gb; ++k) {
+            if(count >= max) return -1;
+            t[count++]= (k - ga) * inv;
+        }
+    } else {
+        for (int k = std::min(n - 1, (int)ceilf(ga) - 1); k >= 0 && k > gb; --k) {
+            if(count >= max) return -1;
+            t[count++]= (k - ga) * inv;
+        }
+    }
+    return count;
+}
+
+// bounds on the second derivatives of the loaded cell anywhere in it, from |rx^i * ry^j| <= 1
+void GridInterpolator::cell_bends(float& bxx, float& bxy, float& byy) const
+{
+    if(coeffs == nullptr) {
+        bxx= byy= 0;
+        bxy= fabsf(c3);
+        return;
+    }
+
+    bxx= bxy= byy= 0;
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            float c= fabsf(cell[i * 4 + j]);
+            bxx += c * (i * (i - 1));
+            bxy += c * (i * j);
+            byy += c * (j * (j - 1));
+        }
+    }
+}
+
+int GridInterpolator::split_line(float xa, float ya, float xb, float yb, float tolerance, float *t, int max)
+{
+    // past the edges of the grid the offset only changes along the edge, so the grid lines still mark where it bends
+    float cross[max + 1];
+    int ncx= crossings((xa - x0) * inv_dx, (xb - x0) * inv_dx, nx, cross, max);
+    if(ncx < 0) return -1;
+    int ncy= crossings((ya - y0) * inv_dy, (yb - y0) * inv_dy, ny, &cross[ncx], max - ncx);
+    if(ncy < 0) return -1;
+    std::inplace_merge(cross, cross + ncx, cross + ncx + ncy);
+    cross[ncx + ncy]= 1.0F;
+
+    // between crossings the line stays in one cell and the offset along it is a polynomial, so a chord strays from it by
+    // at most |z''| / 8. moving a, b grid units over the chord z'' = a^2 z_xx + 2ab z_xy + b^2 z_yy, which is exact for
+    // bilinear where only z_xy = c3 is not zero, and is bounded from the cell coefficients for bicubic
+    float dx= xb - xa, dy= yb - ya;
+    int count= 0;
+    float ta= 0;
+    for (int i = 0; i <= ncx + ncy; ++i) {
+        float tb= cross[i];
+        if(tb - ta < 1e-6F) continue;
+
+        float gxa, gya, gxb, gyb, gxm, gym;
+        grid_point(xa + dx * ta, ya + dy * ta, gxa, gya);
+        grid_point(xa + dx * tb, ya + dy * tb, gxb, gyb);
+        grid_point(xa + dx * (ta + tb) * 0.5F, ya + dy * (ta + tb) * 0.5F, gxm, gym);
+        int cx= gxm, cy= gym;
+        if(cx != cell_x || cy != cell_y) load_cell(cx, cy);
+
+        float bxx, bxy, byy;
+        cell_bends(bxx, bxy, byy);
+        float a= fabsf(gxb - gxa), b= fabsf(gyb - gya);
+        float bend= a * a * bxx + 2 * a * b * bxy + b * b * byy;
+
+        // m equal pieces stray by at most bend / (8 * m^2)
+        int pieces= 1;
+        if(bend > 8 * tolerance) {
+            float m= ceilf(sqrtf(bend / (8 * tolerance)));
+            if(m > max) return -1;
+            pieces= m;
+        }
+        for (int j = 1; j < pieces; ++j) {
+            if(count >= max) return -1;
+            t[count++]= ta + (tb - ta) * j / pieces;
+        }
+
+        if(i < ncx + ncy) {
+            if(count >= max) return -1;
+            t[count++]= tb;
+        }
+        ta= tb;
+    }
+
+    return count;
+}
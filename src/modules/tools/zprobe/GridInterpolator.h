@@ -0,0 +1,60 @@
+#ifndef __GRIDINTERPOLATOR_H
+#define __GRIDINTERPOLATOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Interpolates the height offset at a point from a regular grid of probed heights, for the grid leveling strategies.
+// Everything that only changes with the grid is worked out once in set_grid(), and the last cell used is kept as
+// z = c0 + c1 * rx + c2 * ry + c3 * rx * ry, with rx, ry the position inside the cell, so the points of a move that stay
+// in one cell, which is most of them, cost a couple of multiply adds.
+//
+// Given somewhere to put them, it instead fits a Catmull-Rom bicubic through the grid points, which follows a warped bed
+// between the points much more closely so a coarser grid does the same job. The 16 coefficients of every cell are worked
+// out in set_grid(), so a point costs 15 multiply adds whichever cell it is in.
+class GridInterpolator
+{
+public:
+    GridInterpolator();
+
+    // grid is nx by ny heights in x major order, grid point 0,0 is at x0,y0 and they are dx,dy apart, which may be
+    // negative. the grid is not copied, call set_grid() again whenever it changes.
+    // bicubic is bicubic_size() floats for the coefficients, or nullptr for bilinear
+    void set_grid(const float *grid, uint8_t nx, uint8_t ny, float x0, float y0, float dx, float dy, float *bicubic= nullptr);
+    void clear();
+    bool is_set() const { return grid != nullptr; }
+    bool is_bicubic() const { return coeffs != nullptr; }
+
+    static size_t bicubic_size(uint8_t nx, uint8_t ny) { return (nx - 1) * (ny - 1) * 16; }
+
+    // points off the grid get the height at the nearest edge, NaN if the cell was not probed
+    float get_offset(float x, float y);
+
+    // where a straight line from xa,ya to xb,yb has to be broken so that the offsets at the ends of the pieces, joined by
+    // straight lines, stay within tolerance of the surface. t gets the breaks in order as fractions of the line, which is
+    // broken where it crosses a grid line and again where it bends too far inside a cell. returns how many, or -1 if that
+    // is more than max
+    int split_line(float xa, float ya, float xb, float yb, float tolerance, float *t, int max);
+
+private:
+    void grid_point(float x, float y, float& gx, float& gy) const;
+    void load_cell(int cx, int cy);
+    void cell_bends(float& bxx, float& bxy, float& byy) const;
+    float point(int x, int y) const;
+    void fit_cell(int cx, int cy, float *c) const;
+    static int crossings(float ga, float gb, int n, float *t, int max);
+
+    const float *grid;
+    float *coeffs;
+    float x0, y0;
+    float inv_dx, inv_dy;
+    // the largest grid coordinate, just short of the last line so the cell to the right or above always exists
+    float max_gx, max_gy;
+    uint8_t nx, ny;
+
+    int cell_x, cell_y;
+    float c0, c1, c2, c3;
+    const float *cell;
+};
+
+#endif
@@ -16,6 +16,7 @@
 
 #include "mbed.h" // for SPI
 #include "swspi/SWSPI.h" // for SWSPI
+#include "SPIQueue.h"
 
 #include "drivers/TMC26X/TMC26X.h"
 #include "drivers/DRV8711/drv8711.h"
@@ -47,6 +48,8 @@
 
 MotorDriverControl::MotorDriverControl(uint8_t id) : id(id)
 {
+    spi_queue= nullptr;
+    spi= nullptr;
     enable_event= false;
     current_override= false;
     microstep_override= false;
@@ -142,7 +145,7 @@ bool MotorDriverControl::config_module(uint16_t cs)
 
     // select which SPI channel to use
     int spi_channel = THEKERNEL->config->value(motor_driver_control_checksum, cs, spi_channel_checksum)->by_default(1)->as_number();
-    int spi_frequency = THEKERNEL->config->value(motor_driver_control_checksum, cs, spi_frequency_checksum)->by_default(1000000)->as_number();
+    spi_frequency = THEKERNEL->config->value(motor_driver_control_checksum, cs, spi_frequency_checksum)->by_default(1000000)->as_number();
 
     // select SPI channel to use
     PinName mosi, miso, sclk;
@@ -170,11 +173,12 @@ bool MotorDriverControl::config_module(uint16_t cs)
         THEKERNEL->streams->printf("MotorDriverControl %c INFO: swspi init\r\n", axis);
         this->spi = new SWSPI(mosi, miso, sclk);
         THEKERNEL->streams->printf("MotorDriverControl %c INFO: swspi init done\r\n", axis);
+        this->spi->frequency(spi_frequency);
+        this->spi->format(8, 3); // 8bit, mode3
     }else{
-        this->spi = new mbed::SPI(mosi, miso, sclk);
+        // shares the channel with any sensors on it, 8bit, mode3 is set per transfer
+        this->spi_queue = SPIQueue::channel(spi_channel);
     }
-    this->spi->frequency(spi_frequency);
-    this->spi->format(8, 3); // 8bit, mode3
 
     // set default max currents for each chip, can be overidden in config
     switch(chip) {
@@ -643,7 +647,18 @@ void MotorDriverControl::WriteReadSPIstr(const char* p, StreamOutput* stream)
 // Called by the drivers codes to send and receive SPI data to/from the chip
 int MotorDriverControl::sendSPI(uint8_t *b, int cnt, uint8_t *r /* =0 */)
 {
-    if (b && cnt) {
+    if (b && cnt && spi_queue != nullptr) {
+        SPITransaction t;
+        t.cs = &spi_cs_pin;
+        t.tx = b;
+        t.rx = r;
+        t.n = cnt;
+        t.bits = 8;
+        t.mode = 3;
+        t.frequency = spi_frequency;
+        spi_queue->transfer(&t);
+
+    } else if (b && cnt) {
         uint8_t x;
         spi_cs_pin.set(0);
         for (int i = 0; i < cnt; ++i) {
@@ -9,6 +9,7 @@ namespace mbed {
     class SPI;
 }
 
+class SPIQueue;
 class DRV8711DRV;
 class TMC26X;
 class StreamOutput;
@@ -43,7 +44,10 @@ class MotorDriverControl : public Module {
         int sendSPI(uint8_t *b, int cnt, uint8_t *r=NULL);
 
         Pin spi_cs_pin;
+        // the hardware channels go through the queue, software spi is driven directly
+        SPIQueue *spi_queue;
         mbed::SPI *spi;
+        uint32_t spi_frequency;
 
         enum CHIP_TYPE {
             SPIDRVR,
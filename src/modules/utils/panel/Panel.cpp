@@ -14,6 +14,7 @@
 #include "Button.h"
 #include "libs/USBDevice/USBMSD/SDCard.h"
 #include "libs/SDFAT.h"
+#include "libs/SPIQueue.h"
 
 #include "modules/utils/player/PlayerPublicAccess.h"
 #include "CustomScreen.h"
@@ -134,12 +135,16 @@ void Panel::on_module_loaded()
         return;
     }
 
+    // the lcd drives its spi channel itself, keep queued transfers on it to the main loop
+    SPIQueue::share(THEKERNEL->config->value(panel_checksum, spi_channel_checksum)->by_default(0)->as_number());
+
     // external sd
     if(THEKERNEL->config->value( panel_checksum, ext_sd_checksum )->by_default(false)->as_bool()) {
         this->external_sd_enable= true;
         // external sdcard detect
         this->sdcd_pin.from_string(THEKERNEL->config->value( panel_checksum, ext_sd_checksum, sdcd_pin_checksum )->by_default("nc")->as_string())->as_input();
         this->extsd_spi_channel = THEKERNEL->config->value(panel_checksum, ext_sd_checksum, spi_channel_checksum)->by_default(0)->as_number();
+        SPIQueue::share(this->extsd_spi_channel);
         string s= THEKERNEL->config->value( panel_checksum, ext_sd_checksum, spi_cs_pin_checksum)->by_default("2.8")->as_string();
         s= "P" + s; // Pinnames need to be Px_x
         this->extsd_spi_cs= parse_pins(s.c_str());
@@ -201,7 +206,7 @@ void Panel::on_module_loaded()
     // Register for events
     this->register_for_event(ON_IDLE);
     this->register_for_event(ON_MAIN_LOOP);
-    this->register_for_event(ON_SET_PUBLIC_DATA);
+    this->register_for_public_data(ON_SET_PUBLIC_DATA, panel_checksum);
 
     // Refresh timer
     THEKERNEL->slow_ticker->attach( 20, this, &Panel::refresh_tick );
@@ -41,6 +41,10 @@
 #define after_suspend_gcode_checksum      CHECKSUM("after_suspend_gcode")
 #define before_resume_gcode_checksum      CHECKSUM("before_resume_gcode")
 #define leave_heaters_on_suspend_checksum CHECKSUM("leave_heaters_on_suspend")
+#define player_read_ahead_size_checksum   CHECKSUM("player_read_ahead_size")
+#define player_dispatch_budget_checksum   CHECKSUM("player_dispatch_budget_us")
+#define player_heatshrink_window_checksum CHECKSUM("player_heatshrink_window")
+#define player_heatshrink_lookahead_checksum CHECKSUM("player_heatshrink_lookahead")
 
 extern SDFAT mounter;
 
@@ -53,15 +57,19 @@ Player::Player()
     this->reply_stream = nullptr;
     this->suspended= false;
     this->suspend_loops= 0;
+    this->dispatch_passes= 0;
+    this->dispatch_lines= 0;
+    this->dispatch_max_lines= 0;
 }
 
 void Player::on_module_loaded()
 {
     this->register_for_event(ON_CONSOLE_LINE_RECEIVED);
     this->register_for_event(ON_MAIN_LOOP);
+    this->register_for_event(ON_IDLE);
     this->register_for_event(ON_SECOND_TICK);
-    this->register_for_event(ON_GET_PUBLIC_DATA);
-    this->register_for_event(ON_SET_PUBLIC_DATA);
+    this->register_for_public_data(ON_GET_PUBLIC_DATA, player_checksum);
+    this->register_for_public_data(ON_SET_PUBLIC_DATA, player_checksum);
     this->register_for_event(ON_GCODE_RECEIVED);
     this->register_for_event(ON_HALT);
 
@@ -73,6 +81,18 @@ void Player::on_module_loaded()
     std::replace( this->after_suspend_gcode.begin(), this->after_suspend_gcode.end(), '_', ' '); // replace _ with space
     std::replace( this->before_resume_gcode.begin(), this->before_resume_gcode.end(), '_', ' '); // replace _ with space
     this->leave_heaters_on = THEKERNEL->config->value(leave_heaters_on_suspend_checksum)->by_default(false)->as_bool();
+
+    // size of each of the two read ahead buffers, rounded down to a multiple of the SD sector size
+    this->read_ahead_size = THEKERNEL->config->value(player_read_ahead_size_checksum)->by_default(2048)->as_int();
+
+    // if set lines are fed until the queue is full or this many us have been spent, otherwise one line is fed per main loop
+    this->dispatch_budget_us = THEKERNEL->config->value(player_dispatch_budget_checksum)->by_default(0)->as_int();
+
+    // parameters used to compress .hs files, the defaults are the same as the heatshrink command line tool
+    this->heatshrink_window = THEKERNEL->config->value(player_heatshrink_window_checksum)->by_default(11)->as_int();
+    this->heatshrink_lookahead = THEKERNEL->config->value(player_heatshrink_lookahead_checksum)->by_default(4)->as_int();
+    if(this->heatshrink_window < 4 || this->heatshrink_window > 14) this->heatshrink_window = 11;
+    if(this->heatshrink_lookahead < 3 || this->heatshrink_lookahead >= this->heatshrink_window) this->heatshrink_lookahead = 4;
 }
 
 void Player::on_halt(void* argument)
@@ -127,8 +147,11 @@ void Player::on_gcode_received(void *argument)
 
             if(this->current_file_handler != NULL) {
                 this->playing_file = false;
-                fclose(this->current_file_handler);
+                close_file();
             }
+            // progress is for the new file even if it fails to open
+            this->played_cnt = 0;
+            this->elapsed_secs = 0;
             this->current_file_handler = fopen( this->filename.c_str(), "r");
 
             if(this->current_file_handler == NULL) {
@@ -144,14 +167,11 @@ void Player::on_gcode_received(void *argument)
                     this->file_size = ftell(this->current_file_handler);
                     fseek(this->current_file_handler, 0, SEEK_SET);
                 }
+                if(!start_read_ahead(this->filename, gcode->stream)) return;
                 gcode->stream->printf("File opened:%s Size:%ld\r\n", this->filename.c_str(), this->file_size);
                 gcode->stream->printf("File selected\r\n");
             }
 
-
-            this->played_cnt = 0;
-            this->elapsed_secs = 0;
-
         } else if (gcode->m == 24) { // start print
             if (this->current_file_handler != NULL) {
                 this->playing_file = true;
@@ -178,7 +198,7 @@ void Player::on_gcode_received(void *argument)
 
                     if(this->current_file_handler == NULL) {
                         gcode->stream->printf("file.open failed: %s\r\n", currentfn.c_str());
-                    } else {
+                    } else if(start_read_ahead(currentfn, gcode->stream)) {
                         this->filename = currentfn;
                         this->file_size = old_size;
                         this->current_stream = nullptr;
@@ -198,15 +218,13 @@ void Player::on_gcode_received(void *argument)
 
             if(this->current_file_handler != NULL) {
                 this->playing_file = false;
-                fclose(this->current_file_handler);
+                close_file();
             }
 
             this->current_file_handler = fopen( this->filename.c_str(), "r");
             if(this->current_file_handler == NULL) {
                 gcode->stream->printf("file.open failed: %s\r\n", this->filename.c_str());
             } else {
-                this->playing_file = true;
-
                 // get size of file
                 int result = fseek(this->current_file_handler, 0, SEEK_END);
                 if (0 != result) {
@@ -215,6 +233,7 @@ void Player::on_gcode_received(void *argument)
                         file_size = ftell(this->current_file_handler);
                         fseek(this->current_file_handler, 0, SEEK_SET);
                 }
+                this->playing_file = start_read_ahead(this->filename, gcode->stream);
             }
 
             this->played_cnt = 0;
@@ -287,7 +306,7 @@ void Player::play_command( string parameters, StreamOutput *stream )
     }
 
     if(this->current_file_handler != NULL) { // must have been a paused print
-        fclose(this->current_file_handler);
+        close_file();
     }
 
     this->current_file_handler = fopen( this->filename.c_str(), "r");
@@ -298,8 +317,6 @@ void Player::play_command( string parameters, StreamOutput *stream )
 
     stream->printf("Playing %s\r\n", this->filename.c_str());
 
-    this->playing_file = true;
-
     // Output to the current stream if we were passed the -v ( verbose ) option
     if( options.find_first_of("Vv") == string::npos ) {
         this->current_stream = nullptr;
@@ -318,6 +335,10 @@ void Player::play_command( string parameters, StreamOutput *stream )
         fseek(this->current_file_handler, 0, SEEK_SET);
         stream->printf("  File size %ld\r\n", file_size);
     }
+
+    if(!start_read_ahead(this->filename, stream)) return;
+
+    this->playing_file = true;
     this->played_cnt = 0;
     this->elapsed_secs = 0;
 }
@@ -329,6 +350,15 @@ void Player::progress_command( string parameters, StreamOutput *stream )
     string options = shift_parameter( parameters );
     bool sdprinting= options.find_first_of("Bb") != string::npos;
 
+    if(options.find_first_of("Ss") != string::npos) {
+        // SD read and dispatch statistics for the current or last played file
+        this->read_ahead.dump_stats(stream);
+        if(this->dispatch_passes > 0) {
+            stream->printf("lines per pass avg: %1.2f, max: %lu, budget: %lu us\n", (float)this->dispatch_lines / this->dispatch_passes, this->dispatch_max_lines, this->dispatch_budget_us);
+        }
+        return;
+    }
+
     if(!playing_file && current_file_handler != NULL) {
         if(sdprinting)
             stream->printf("SD printing byte %lu/%lu\r\n", played_cnt, file_size);
@@ -378,8 +408,7 @@ void Player::abort_command( string parameters, StreamOutput *stream )
     file_size = 0;
     this->filename = "";
     this->current_stream = NULL;
-    fclose(current_file_handler);
-    current_file_handler = NULL;
+    close_file();
     if(parameters.empty()) {
         // clear out the block queue, will wait until queue is empty
         // MUST be called in on_main_loop to make sure there are no blocked main loops waiting to put something on the queue
@@ -416,44 +445,48 @@ void Player::on_main_loop(void *argument)
         }
 
         char buf[130]; // lines upto 128 characters are allowed, anything longer is discarded
-        bool discard = false;
-
-        while(fgets(buf, sizeof(buf), this->current_file_handler) != NULL) {
-            int len = strlen(buf);
-            if(len == 0) continue; // empty line? should not be possible
-            if(buf[len - 1] == '\n' || feof(this->current_file_handler)) {
-                if(discard) { // we are discarding a long line
-                    discard = false;
-                    continue;
-                }
-                if(len == 1) continue; // empty line
+        bool discard;
+        size_t len;
+        uint32_t lines = 0;
+        uint32_t start = us_ticker_read(); // mbed call
+
+        // lines are parsed from the read ahead buffer, the SD card is only read when a buffer has been used up
+        while((len = this->read_ahead.get_line(buf, sizeof(buf), discard)) > 0) {
+            played_cnt = this->read_ahead.position();
+            if(discard) {
+                // discard long line
+                if(this->current_stream != nullptr) { this->current_stream->printf("Warning: Discarded long line\n"); }
+                continue;
+            }
+            if(buf[0] == '\n') continue; // empty line
 
-                if(this->current_stream != nullptr) {
-                    this->current_stream->printf("%s", buf);
-                }
+            if(this->current_stream != nullptr) {
+                this->current_stream->printf("%s", buf);
+            }
 
-                struct SerialMessage message;
-                message.message = buf;
-                message.stream = this->current_stream == nullptr ? &(StreamOutput::NullStream) : this->current_stream;
+            struct SerialMessage message;
+            message.message = buf;
+            message.stream = this->current_stream == nullptr ? &(StreamOutput::NullStream) : this->current_stream;
 
-                // waits for the queue to have enough room
-                THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message);
-                played_cnt += len;
-                return; // we feed one line per main loop
+            // waits for the queue to have enough room, the back buffer gets filled in on_idle while we wait
+            THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message);
+            lines++;
 
-            } else {
-                // discard long line
-                if(this->current_stream != nullptr) { this->current_stream->printf("Warning: Discarded long line\n"); }
-                discard = true;
+            // we feed one line per main loop unless there is a dispatch budget, in which case keep going until the
+            // queue is full or the budget is used up. stop if the line aborted or suspended the play or halted
+            if(this->dispatch_budget_us == 0 || !this->playing_file || THEKERNEL->is_halted() || THECONVEYOR->is_queue_full() ||
+               (us_ticker_read() - start) >= this->dispatch_budget_us) {
+                record_dispatch(lines);
+                return;
             }
         }
+        record_dispatch(lines);
 
         this->playing_file = false;
         this->filename = "";
         played_cnt = 0;
         file_size = 0;
-        fclose(this->current_file_handler);
-        current_file_handler = NULL;
+        close_file();
         this->current_stream = NULL;
 
         if(this->reply_stream != NULL) {
@@ -464,6 +497,50 @@ void Player::on_main_loop(void *argument)
     }
 }
 
+// this is called while the main loop is waiting for room in the queue, which is a good time to read ahead from the SD card
+void Player::on_idle(void *argument)
+{
+    if(this->playing_file) {
+        this->read_ahead.prefetch();
+    }
+}
+
+// keep track of how many lines were fed in one main loop pass
+void Player::record_dispatch(uint32_t lines)
+{
+    if(lines == 0) return;
+    this->dispatch_passes++;
+    this->dispatch_lines += lines;
+    if(lines > this->dispatch_max_lines) this->dispatch_max_lines = lines;
+}
+
+// setup the read ahead for the just opened file, the file is closed if there is not enough memory for the buffers
+// files ending in .hs are heatshrink compressed and are decompressed as they are read
+bool Player::start_read_ahead(const string& fn, StreamOutput *stream)
+{
+    this->dispatch_passes = 0;
+    this->dispatch_lines = 0;
+    this->dispatch_max_lines = 0;
+
+    bool compressed = fn.size() > 3 && lc(fn.substr(fn.size() - 3)) == ".hs";
+    if(this->read_ahead.open(this->current_file_handler, this->read_ahead_size, compressed ? this->heatshrink_window : 0, this->heatshrink_lookahead)) {
+        if(compressed) stream->printf("  Decompressing heatshrink file\r\n");
+        return true;
+    }
+
+    stream->printf("Not enough memory to play file: %s\r\n", fn.c_str());
+    fclose(this->current_file_handler);
+    this->current_file_handler = NULL;
+    return false;
+}
+
+void Player::close_file()
+{
+    this->read_ahead.close();
+    fclose(this->current_file_handler);
+    this->current_file_handler = NULL;
+}
+
 void Player::on_get_public_data(void *argument)
 {
     PublicDataRequest *pdr = static_cast<PublicDataRequest *>(argument);
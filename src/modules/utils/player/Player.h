@@ -9,6 +9,7 @@
 #pragma once
 
 #include "Module.h"
+#include "ReadAheadBuffer.h"
 
 #include <stdio.h>
 #include <string>
@@ -25,6 +26,7 @@ class Player : public Module {
         void on_module_loaded();
         void on_console_line_received( void* argument );
         void on_main_loop( void* argument );
+        void on_idle( void* argument );
         void on_second_tick(void* argument);
         void on_get_public_data(void* argument);
         void on_set_public_data(void* argument);
@@ -39,6 +41,9 @@ class Player : public Module {
         void resume_command( string parameters, StreamOutput* stream );
         string extract_options(string& args);
         void suspend_part2();
+        bool start_read_ahead(const string& fn, StreamOutput* stream);
+        void close_file();
+        void record_dispatch(uint32_t lines);
 
         string filename;
         string after_suspend_gcode;
@@ -48,6 +53,14 @@ class Player : public Module {
         StreamOutput* reply_stream;
 
         FILE* current_file_handler;
+        ReadAheadBuffer read_ahead;
+        size_t read_ahead_size;
+        uint32_t dispatch_budget_us;
+        uint8_t heatshrink_window;
+        uint8_t heatshrink_lookahead;
+        uint32_t dispatch_passes;
+        uint32_t dispatch_lines;
+        uint32_t dispatch_max_lines;
         long file_size;
         unsigned long played_cnt;
         unsigned long elapsed_secs;
@@ -0,0 +1,274 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ReadAheadBuffer.h"
+
+#include "libs/StreamOutput.h"
+#include "platform_memory.h"
+#include "HeatshrinkDecoder.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "mbed.h"
+
+// reads are done in multiples of the SD sector size
+#define SECTOR_SIZE 512
+// size of the compressed data read at a time
+#define STAGING_SIZE (SECTOR_SIZE * 2)
+
+// upper bounds of the read latency histogram buckets in us, the last bucket catches the rest
+static const uint32_t histogram_limits[]= { 2000, 10000, 50000, 100000 };
+
+ReadAheadBuffer::ReadAheadBuffer()
+{
+    this->fp= nullptr;
+    this->buffers[0].data= nullptr;
+    this->buffers[1].data= nullptr;
+    this->buffer_size= 0;
+    this->consumed_total= 0;
+    this->decoder= nullptr;
+    this->staging= nullptr;
+    this->in_ahb0= false;
+    this->filling= false;
+    clear_stats();
+}
+
+ReadAheadBuffer::~ReadAheadBuffer()
+{
+    close();
+}
+
+// attach to an open file and allocate the two buffers of size bytes each, size is rounded down to a whole number of sectors
+// AHB0 is tried first then the heap, halving the size until it fits
+// if window_bits is set the file is heatshrink compressed with the given parameters, and room for the window and
+// compressed data is allocated as well
+bool ReadAheadBuffer::open(FILE *fp, size_t size, uint8_t window_bits, uint8_t lookahead_bits)
+{
+    close();
+
+    size -= size % SECTOR_SIZE;
+    if(size < SECTOR_SIZE) size= SECTOR_SIZE;
+
+    size_t extra= 0;
+    if(window_bits > 0) {
+        extra= STAGING_SIZE + HeatshrinkDecoder::window_size(window_bits);
+    }
+
+    char *mem= nullptr;
+    while(mem == nullptr) {
+        mem= (char *)AHB0.alloc(size * 2 + extra);
+        if(mem != nullptr) {
+            this->in_ahb0= true;
+            break;
+        }
+        mem= (char *)malloc(size * 2 + extra);
+        if(mem != nullptr) {
+            this->in_ahb0= false;
+            break;
+        }
+        if(size == SECTOR_SIZE) return false;
+        size /= 2;
+        size -= size % SECTOR_SIZE;
+    }
+
+    // we do our own buffering so the stdio buffer would just be an extra copy, and would break the sector alignment of the reads
+    setvbuf(fp, NULL, _IONBF, 0);
+
+    this->fp= fp;
+    this->buffer_size= size;
+    this->buffers[0]= {mem, 0, 0};
+    this->buffers[1]= {mem + size, 0, 0};
+    this->current= 0;
+    this->eof= false;
+    this->source_eof= false;
+    this->consumed_total= 0;
+    clear_stats();
+
+    if(window_bits > 0) {
+        this->staging= mem + size * 2;
+        this->staging_len= 0;
+        this->staging_pos= 0;
+        this->decoder= new HeatshrinkDecoder((uint8_t *)this->staging + STAGING_SIZE, window_bits, lookahead_bits);
+    }
+
+    // first block has to be read now
+    fill(0);
+    return true;
+}
+
+// releases the buffers, the file itself is closed by the caller
+void ReadAheadBuffer::close()
+{
+    if(this->buffers[0].data != nullptr) {
+        if(this->in_ahb0) AHB0.dealloc(this->buffers[0].data);
+        else free(this->buffers[0].data);
+    }
+    this->buffers[0]= {nullptr, 0, 0};
+    this->buffers[1]= {nullptr, 0, 0};
+    this->fp= nullptr;
+    delete this->decoder;
+    this->decoder= nullptr;
+    this->staging= nullptr;
+}
+
+// how far into the file we are, for compressed files this is how much compressed data has been decoded
+// which is ahead of the lines actually returned by up to the read ahead
+uint32_t ReadAheadBuffer::position() const
+{
+    if(this->decoder != nullptr) return this->read_bytes - (this->staging_len - this->staging_pos);
+    return this->consumed_total;
+}
+
+// timed read from the file, updates the read statistics
+size_t ReadAheadBuffer::read_block(char *buf, size_t size)
+{
+    uint32_t t= us_ticker_read(); // mbed call
+    size_t cnt= fread(buf, 1, size, this->fp);
+    t= us_ticker_read() - t;
+
+    this->read_cnt++;
+    this->read_bytes += cnt;
+    this->read_total_us += t;
+    if(t < this->read_min_us) this->read_min_us= t;
+    if(t > this->read_max_us) this->read_max_us= t;
+    size_t i= 0;
+    while(i < sizeof(histogram_limits) / sizeof(histogram_limits[0]) && t >= histogram_limits[i]) i++;
+    this->read_histogram[i]++;
+
+    return cnt;
+}
+
+// read the next block of the file into buffer n
+bool ReadAheadBuffer::fill(uint8_t n)
+{
+    if(this->fp == nullptr || this->eof || this->filling) return false;
+    this->filling= true;
+
+    buffer_t& b= this->buffers[n];
+    b.pos= 0;
+
+    if(this->decoder == nullptr) {
+        b.len= read_block(b.data, this->buffer_size);
+        if(b.len < this->buffer_size) this->eof= true; // short read is end of file or a read error, either way we are done
+
+    } else {
+        // decode until the buffer is full, reading more compressed data whenever the decoder runs out
+        b.len= 0;
+        while(true) {
+            size_t used;
+            size_t cnt= this->decoder->decode((uint8_t *)this->staging + this->staging_pos, this->staging_len - this->staging_pos, used,
+                                              (uint8_t *)b.data + b.len, this->buffer_size - b.len);
+            this->staging_pos += used;
+            b.len += cnt;
+            this->decoded_bytes += cnt;
+            if(b.len >= this->buffer_size) break;
+
+            // the decoder stopped before the buffer was full so it needs more input
+            if(this->source_eof) {
+                this->eof= true;
+                break;
+            }
+            this->staging_len= read_block(this->staging, STAGING_SIZE);
+            this->staging_pos= 0;
+            if(this->staging_len < STAGING_SIZE) this->source_eof= true;
+        }
+    }
+
+    this->filling= false;
+    return b.len > 0;
+}
+
+// fill the back buffer if it has been consumed, call this when there is time to spare
+bool ReadAheadBuffer::prefetch()
+{
+    if(this->fp == nullptr) return false;
+    uint8_t back= this->current ^ 1;
+    if(this->buffers[back].len != 0) return false;
+    return fill(back);
+}
+
+// copy the next line including the newline into line, which is always nul terminated
+// returns the number of bytes consumed from the file which is zero at end of file
+// a line too long to fit is consumed completely but only the start is copied and truncated is set
+size_t ReadAheadBuffer::get_line(char *line, size_t size, bool& truncated)
+{
+    size_t consumed= 0, n= 0;
+    truncated= false;
+    if(this->fp == nullptr) {
+        line[0]= '\0';
+        return 0;
+    }
+
+    while(true) {
+        buffer_t& b= this->buffers[this->current];
+        if(b.pos >= b.len) {
+            // this buffer is used up, switch to the back buffer reading it now if it was not prefetched
+            b.len= b.pos= 0;
+            buffer_t& back= this->buffers[this->current ^ 1];
+            if(back.len == 0) {
+                if(this->eof) break;
+                this->stall_cnt++;
+                if(!fill(this->current ^ 1)) break;
+            }
+            this->current ^= 1;
+            continue;
+        }
+
+        char *start= b.data + b.pos;
+        size_t avail= b.len - b.pos;
+        char *nl= (char *)memchr(start, '\n', avail);
+        size_t cnt= (nl == nullptr) ? avail : (nl - start) + 1;
+        size_t room= size - 1 - n;
+        if(cnt > room) {
+            memcpy(line + n, start, room);
+            n += room;
+            truncated= true;
+        } else {
+            memcpy(line + n, start, cnt);
+            n += cnt;
+        }
+        b.pos += cnt;
+        consumed += cnt;
+        if(nl != nullptr) break;
+    }
+
+    line[n]= '\0';
+    this->consumed_total += consumed;
+    return consumed;
+}
+
+void ReadAheadBuffer::clear_stats()
+{
+    this->read_cnt= 0;
+    this->read_bytes= 0;
+    this->read_total_us= 0;
+    this->read_min_us= UINT32_MAX;
+    this->read_max_us= 0;
+    memset(this->read_histogram, 0, sizeof(this->read_histogram));
+    this->stall_cnt= 0;
+    this->decoded_bytes= 0;
+}
+
+void ReadAheadBuffer::dump_stats(StreamOutput *stream) const
+{
+    if(this->read_cnt == 0) {
+        stream->printf("No SD reads recorded\n");
+        return;
+    }
+    stream->printf("read ahead: %u bytes x2 in %s\n", this->buffer_size, this->in_ahb0 ? "AHB0" : "heap");
+    stream->printf("SD reads: %lu, bytes: %lu, stalls: %lu\n", this->read_cnt, this->read_bytes, this->stall_cnt);
+    if(this->decoded_bytes > 0) {
+        stream->printf("decompressed bytes: %lu, ratio: %1.2f\n", this->decoded_bytes, (float)this->decoded_bytes / this->read_bytes);
+    }
+    stream->printf("latency us min: %lu, avg: %lu, max: %lu\n", this->read_min_us, this->read_total_us / this->read_cnt, this->read_max_us);
+    if(this->read_total_us > 0) {
+        stream->printf("throughput: %lu KB/s\n", (uint32_t)(((uint64_t)this->read_bytes * 1000000 / this->read_total_us) / 1024));
+    }
+    stream->printf("latency <2ms: %lu, <10ms: %lu, <50ms: %lu, <100ms: %lu, >=100ms: %lu\n",
+        this->read_histogram[0], this->read_histogram[1], this->read_histogram[2], this->read_histogram[3], this->read_histogram[4]);
+}
@@ -0,0 +1,75 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+class StreamOutput;
+class HeatshrinkDecoder;
+
+// Double buffered read ahead for a file being played.
+// The file is read in large sector aligned blocks into one buffer while lines are parsed from the other,
+// prefetch() can be called whenever there is spare time (eg while waiting for the queue) to fill the back buffer ahead of need.
+// heatshrink compressed files are decompressed as the buffers are filled.
+class ReadAheadBuffer {
+    public:
+        ReadAheadBuffer();
+        ~ReadAheadBuffer();
+
+        bool open(FILE *fp, size_t size, uint8_t window_bits= 0, uint8_t lookahead_bits= 0);
+        void close();
+        bool is_open() const { return fp != nullptr; }
+        uint32_t position() const;
+
+        size_t get_line(char *line, size_t size, bool& truncated);
+        bool prefetch();
+
+        void clear_stats();
+        void dump_stats(StreamOutput *stream) const;
+
+    private:
+        bool fill(uint8_t n);
+        size_t read_block(char *buf, size_t size);
+
+        struct buffer_t {
+            char *data;
+            size_t len;
+            size_t pos;
+        };
+
+        FILE *fp;
+        buffer_t buffers[2];
+        size_t buffer_size;
+        uint32_t consumed_total;
+
+        // compressed input staging
+        HeatshrinkDecoder *decoder;
+        char *staging;
+        size_t staging_len;
+        size_t staging_pos;
+        uint32_t decoded_bytes;
+
+        // SD read statistics
+        uint32_t read_cnt;
+        uint32_t read_bytes;
+        uint32_t read_total_us;
+        uint32_t read_min_us;
+        uint32_t read_max_us;
+        uint32_t read_histogram[5];
+        uint32_t stall_cnt;
+
+        struct {
+            uint8_t current:1;
+            bool eof:1;
+            bool source_eof:1;
+            bool in_ahb0:1;
+            bool filling:1;
+        };
+};
@@ -41,6 +41,10 @@
 #include "md5.h"
 #include "utils.h"
 #include "AutoPushPop.h"
+#include "BootProfiler.h"
+#include "EventProfiler.h"
+#include "HeapAccounting.h"
+#include "SlowTicker.h"
 
 #include "system_LPC17xx.h"
 #include "LPC17xx.h"
@@ -78,6 +82,8 @@ const SimpleShell::ptentry_t SimpleShell::commands_table[] = {
     {"?",        SimpleShell::help_command},
     {"version",  SimpleShell::version_command},
     {"mem",      SimpleShell::mem_command},
+    {"bootprof", SimpleShell::bootprof_command},
+    {"evprof",   SimpleShell::evprof_command},
     {"get",      SimpleShell::get_command},
     {"set_temp", SimpleShell::set_temp_command},
     {"switch",   SimpleShell::switch_command},
@@ -610,14 +616,45 @@ void SimpleShell::mem_command( string parameters, StreamOutput *stream)
     stream->printf("Total Free RAM: %lu bytes\r\n", m + f);
 
     stream->printf("Free AHB0: %lu, AHB1: %lu\r\n", AHB0.free(), AHB1.free());
+    Gcode::dump_stats(stream);
     if (verbose) {
         AHB0.debug(stream);
         AHB1.debug(stream);
+#ifdef HEAP_ACCOUNTING
+        HeapAccounting::dump(stream);
+#endif
     }
 
     stream->printf("Block size: %u bytes, Tickinfo size: %u bytes\n", sizeof(Block), sizeof(Block::tickinfo_t) * Block::n_actuators);
 }
 
+// show the boot profile
+void SimpleShell::bootprof_command( string parameters, StreamOutput *stream)
+{
+    BootProfiler::dump(stream);
+}
+
+// turn event profiling on or off, or show the modules using the most time since it was last shown
+void SimpleShell::evprof_command( string parameters, StreamOutput *stream)
+{
+    string arg= shift_parameter( parameters );
+    if(arg == "on") {
+        EventProfiler::enable(true);
+        stream->printf("event profiling on\n");
+
+    } else if(arg == "off") {
+        EventProfiler::enable(false);
+        stream->printf("event profiling off\n");
+
+    } else {
+        int n= arg.empty() ? 20 : strtol(arg.c_str(), NULL, 10);
+        EventProfiler::dump(stream, n);
+        EventProfiler::reset();
+        THEKERNEL->slow_ticker->dump_stats(stream);
+        THEKERNEL->slow_ticker->clear_stats();
+    }
+}
+
 static uint32_t getDeviceType()
 {
 #define IAP_LOCATION 0x1FFF1FF1
@@ -937,6 +974,10 @@ void SimpleShell::calc_thermistor_command( string parameters, StreamOutput *stre
         float c1, c2, c3;
         std::tie(c1, c2, c3) = Thermistor::calculate_steinhart_hart_coefficients(trl[0], trl[1], trl[2], trl[3], trl[4], trl[5]);
         stream->printf("Steinhart Hart coefficients:  I%1.18f J%1.18f K%1.18f\n", c1, c2, c3);
+        ThermistorTable table;
+        if(Thermistor::build_steinhart_hart_table(table, c1, c2, c3, 0.1F)) {
+            stream->printf("  Lookup table with a 4k7 pullup: %u points, max error %1.3f°C\n", table.size(), table.get_max_error());
+        }
         if(saveto == -1) {
             stream->printf("  Paste the above in the M305 S0 command, then save with M500\n");
         }else{
@@ -1272,6 +1313,8 @@ void SimpleShell::help_command( string parameters, StreamOutput *stream )
     stream->printf("Commands:\r\n");
     stream->printf("version\r\n");
     stream->printf("mem [-v]\r\n");
+    stream->printf("bootprof - shows how long each part of boot took and the memory it used\r\n");
+    stream->printf("evprof [on|off] [n] - turns event profiling on or off, or shows the top n modules by time used in each event and resets\r\n");
     stream->printf("ls [-s] [folder]\r\n");
     stream->printf("cd folder\r\n");
     stream->printf("pwd\r\n");
@@ -1280,7 +1323,7 @@ void SimpleShell::help_command( string parameters, StreamOutput *stream )
     stream->printf("mv file newfile\r\n");
     stream->printf("remount\r\n");
     stream->printf("play file [-v]\r\n");
-    stream->printf("progress - shows progress of current play\r\n");
+    stream->printf("progress [-s] - shows progress of current play, -s shows SD read statistics\r\n");
     stream->printf("abort - abort currently playing file\r\n");
     stream->printf("reset - reset smoothie\r\n");
     stream->printf("dfu - enter dfu boot loader\r\n");
@@ -55,6 +55,8 @@ private:
 
     static void switch_command(string parameters, StreamOutput *stream );
     static void mem_command(string parameters, StreamOutput *stream );
+    static void bootprof_command(string parameters, StreamOutput *stream );
+    static void evprof_command(string parameters, StreamOutput *stream );
 
     static void net_command( string parameters, StreamOutput *stream);
 
@@ -15,6 +15,7 @@ This is aprt of the Smoothie test framework, it generates a Mockable Kernl so ke
 #include "libs/nuts_bolts.h"
 #include "libs/SlowTicker.h"
 #include "libs/Adc.h"
+#include "libs/PwmEngine.h"
 #include "libs/StreamOutputPool.h"
 #include <mri.h>
 #include "checksumm.h"
@@ -57,6 +58,7 @@ Kernel::Kernel(){
     this->current_path   = "/";
 
     this->slow_ticker = new SlowTicker();
+    this->pwm_engine = new PwmEngine();
 
     // dummies (would be nice to refactor to not have to create a conveyor)
     this->conveyor= new Conveyor();
@@ -68,7 +70,7 @@ Kernel::Kernel(){
 }
 
 // Add a module to Kernel. We don't actually hold a list of modules we just call its on_module_loaded
-void Kernel::add_module(Module* module){
+void Kernel::add_module(Module* module, const char *name){
     module->on_module_loaded();
 }
 
@@ -77,6 +79,15 @@ void Kernel::register_for_event(_EVENT_ENUM id_event, Module *mod){
     this->hooks[id_event].push_back(mod);
 }
 
+// tests call on_gcode_received directly so there is no routing, the module just gets every gcode
+void Kernel::register_for_gcode(Module *mod, char letter, uint16_t first, uint16_t last){
+    if(!kernel_has_event(ON_GCODE_RECEIVED, mod)) this->hooks[ON_GCODE_RECEIVED].push_back(mod);
+}
+
+void Kernel::unregister_for_gcode(Module *mod){
+    unregister_for_event(ON_GCODE_RECEIVED, mod);
+}
+
 static std::map<_EVENT_ENUM, std::function<void(void*)> > event_callbacks;
 
 // Call a specific event with an argument
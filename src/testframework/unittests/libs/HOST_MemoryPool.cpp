@@ -0,0 +1,168 @@
+// Host benchmark of MemoryPool against the first-fit pool it replaced, not built into the target test image.
+// Build and run from the repository root with:
+//   g++ -O2 -std=gnu++11 -Isrc/libs -Imri '-D__debugbreak()=abort()' src/testframework/unittests/libs/HOST_MemoryPool.cpp src/libs/MemoryPool.cpp -o /tmp/mpbench && /tmp/mpbench
+//
+// A 16KB pool holds eight 400 byte long-lived blocks, like planner or network buffers, while random 8 to 128 byte
+// objects are allocated and freed around a target number of live objects. Both pools see the same sequence.
+
+#include "MemoryPool.h"
+
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// the pool before size classes, first fit over the block headers and coalescing on free
+class FirstFitPool
+{
+public:
+    FirstFitPool(void* base, uint16_t size) : base(base), size(size)
+    {
+        ((region*) base)->used = 0;
+        ((region*) base)->next = size;
+    }
+
+    void* alloc(size_t nbytes)
+    {
+        if (nbytes & 3)
+            nbytes += 4 - (nbytes & 3);
+
+        region* p = (region*) base;
+        uint16_t nsize = nbytes + sizeof(region);
+        do {
+            if ((p->used == 0) && (p->next >= nsize)) {
+                p->used = 1;
+                if (p->next > nsize) {
+                    region* q = (region*) (((uint8_t*) p) + nsize);
+                    q->used = 0;
+                    q->next = p->next - nsize;
+                    p->next = nsize;
+                }
+                return &p->data;
+            }
+            p = (region*) (((uint8_t*) p) + p->next);
+        } while (p < (region*) (((uint8_t*) base) + size));
+
+        return NULL;
+    }
+
+    void dealloc(void* d)
+    {
+        region* p = (region*) (((uint8_t*) d) - sizeof(region));
+        p->used = 0;
+
+        region* q = (region*) (((uint8_t*) p) + p->next);
+        if (q >= (region*) (((uint8_t*) base) + size))
+            return;
+        if (q->used == 0)
+            p->next += q->next;
+
+        // walk the list to find the previous block
+        q = (region*) base;
+        do {
+            if ((((uint8_t*) q) + q->next) == (uint8_t*) p) {
+                if (q->used == 0)
+                    q->next += p->next;
+                return;
+            }
+            if ((uint32_t) (((uint8_t*) q) - ((uint8_t*) base)) + q->next >= size)
+                return;
+            q = (region*) (((uint8_t*) q) + q->next);
+        } while (q != p);
+    }
+
+private:
+    typedef struct __attribute__ ((packed)) {
+        uint32_t next :31;
+        uint32_t used :1;
+        uint8_t data[];
+    } region;
+
+    void* base;
+    uint16_t size;
+};
+
+#define POOL_SIZE   16384
+#define LONG_LIVED  8
+#define SLOTS       128
+#define OPS         1000000
+
+static uint32_t memory[POOL_SIZE / 4];
+
+struct result_t {
+    double ns_per_op;
+    int failed;
+    int allocs;
+};
+
+// same sequence for every run
+static uint32_t seed;
+static uint32_t xorshift()
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+template<class pool_t> static result_t churn(pool_t& pool, int live)
+{
+    void* fixed[LONG_LIVED];
+    void* slot[SLOTS];
+    int nslots = 0;
+    result_t r = {0, 0, 0};
+
+    seed = 2463534242UL;
+    for (int i = 0; i < LONG_LIVED; ++i) {
+        fixed[i] = pool.alloc(400);
+        if (fixed[i] == NULL) ++r.failed;
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < OPS; ++i) {
+        uint32_t x = xorshift();
+        // drift around the target, alloc below it and free above it, either way near it
+        bool grow = nslots == 0 || (nslots < SLOTS && (int) (x % (2 * live)) >= nslots);
+        if (grow) {
+            void* p = pool.alloc(8 + (x >> 8) % 121);
+            ++r.allocs;
+            if (p == NULL) {
+                ++r.failed;
+                continue;
+            }
+            memset(p, 0xA5, 8);
+            slot[nslots++] = p;
+        } else {
+            int k = (x >> 8) % nslots;
+            pool.dealloc(slot[k]);
+            slot[k] = slot[--nslots];
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < nslots; ++i)
+        pool.dealloc(slot[i]);
+    for (int i = 0; i < LONG_LIVED; ++i)
+        if (fixed[i] != NULL) pool.dealloc(fixed[i]);
+
+    r.ns_per_op = std::chrono::duration<double, std::nano>(t1 - t0).count() / OPS;
+    return r;
+}
+
+int main()
+{
+    const int targets[] = {20, 40, 60, 80};
+
+    printf("%d ops, %d byte pool, %d x 400 byte long-lived blocks\n", OPS, POOL_SIZE, LONG_LIVED);
+    printf("live  first-fit ns/op  failed   slabs ns/op  failed\n");
+    for (int live : targets) {
+        FirstFitPool old_pool(memory, sizeof(memory));
+        result_t a = churn(old_pool, live);
+
+        MemoryPool new_pool(memory, sizeof(memory));
+        result_t b = churn(new_pool, live);
+
+        printf("%4d  %15.0f  %6d  %12.0f  %6d   of %d allocs\n", live, a.ns_per_op, a.failed, b.ns_per_op, b.failed, b.allocs);
+    }
+    return 0;
+}
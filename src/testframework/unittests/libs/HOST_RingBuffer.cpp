@@ -0,0 +1,233 @@
+// Host stress test and throughput benchmark of RingBuffer, not built into the target test image.
+// Build and run from the repository root with:
+//   g++ -O2 -std=gnu++11 -pthread -Isrc/libs src/testframework/unittests/libs/HOST_RingBuffer.cpp -o /tmp/rbstress && /tmp/rbstress
+//
+// The producer thread stands in for an ISR and the main thread for the main loop. It exits non zero if anything is lost,
+// duplicated or reordered. A host with one core still preempts the threads at random points, which is what an ISR does.
+
+#include "RingBuffer.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <thread>
+
+#define ITEMS       4000000
+#define JUNK        0xFFFFFFFFUL
+
+static uint32_t xorshift(uint32_t& s)
+{
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    return s;
+}
+
+// single and bulk pushes against single and bulk pops, every item must come out once and in order
+static bool plain_spsc()
+{
+    static RingBuffer<uint32_t, 256> rb;
+    bool ok = true;
+
+    std::thread producer([] {
+        uint32_t s = 2463534242UL, tmp[17];
+        uint32_t i = 0;
+        while (i < ITEMS) {
+            uint32_t x = xorshift(s);
+            if (x & 1) {
+                uint32_t n = 1 + (x >> 8) % 17;
+                for (uint32_t k = 0; k < n; ++k) tmp[k] = i + k;
+                if (i + n > ITEMS) n = ITEMS - i;
+                i += rb.push_back(tmp, n);
+            } else if (rb.push_back(i)) {
+                ++i;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint32_t s = 88675123UL, expect = 0, tmp[13];
+    while (expect < ITEMS) {
+        uint32_t x = xorshift(s), v;
+        if (x & 1) {
+            size_t n = rb.pop_front(tmp, 1 + (x >> 8) % 13);
+            for (size_t k = 0; k < n; ++k)
+                if (tmp[k] != expect++) ok = false;
+            if (n == 0) std::this_thread::yield();
+        } else if (rb.pop_front(v)) {
+            if (v != expect++) ok = false;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+
+    printf("plain SPSC, %d items: %s\n", ITEMS, ok ? "ok" : "FAILED");
+    return ok && rb.empty();
+}
+
+// the producer also takes back its last push with pop_back and drops everything with flush, as the USB endpoint ISR does.
+// As RingBuffer.h says the consumer then has to keep the producer out of its pops, here a mutex stands in for
+// __disable_irq and the producer holds it for each of its steps as an ISR runs to completion.
+// Junk that was taken back must never be seen, and what is seen must still be in order with nothing repeated.
+static bool guarded_pop_back_flush()
+{
+    static RingBuffer<uint32_t, 64> rb;
+    static std::mutex irq;
+    static std::atomic<bool> done(false);
+    static uint32_t pop_backs = 0, flushes = 0;
+    bool ok = true;
+
+    std::thread producer([] {
+        uint32_t s = 2463534242UL;
+        uint32_t i = 0;
+        while (i < ITEMS) {
+            uint32_t x = xorshift(s);
+            {
+                std::lock_guard<std::mutex> lock(irq);
+                if ((x & 0xFF) == 0) {
+                    rb.flush();
+                    ++flushes;
+                } else if ((x & 0x7) == 1) {
+                    if (rb.push_back(JUNK)) {
+                        rb.pop_back();
+                        ++pop_backs;
+                    }
+                } else if (rb.push_back(i)) {
+                    ++i;
+                }
+            }
+            if (rb.full()) std::this_thread::yield();
+        }
+        done = true;
+    });
+
+    uint32_t last = 0, seen = 0;
+    bool first = true;
+    while (true) {
+        if (rb.empty()) {
+            if (done) break;
+            std::this_thread::yield();
+            continue;
+        }
+
+        uint32_t v;
+        bool got;
+        {
+            std::lock_guard<std::mutex> lock(irq);
+            // can have been flushed since empty() was checked
+            got = rb.pop_front(v);
+        }
+        if (!got) continue;
+
+        if (v == JUNK || (!first && v <= last)) ok = false;
+        first = false;
+        last = v;
+        ++seen;
+    }
+    producer.join();
+
+    ok = ok && pop_backs > 0 && flushes > 0;
+    printf("guarded pop_back and flush, %d items, %u seen, %u pop_backs, %u flushes: %s\n", ITEMS, seen, pop_backs, flushes, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+// the ring USBSerial used before, modulo indices and one slot unused, without the interrupt disabling it also did
+template<class T, int size> class OldCircBuffer {
+public:
+    OldCircBuffer() : write(0), read(0) {}
+    bool isFull() { return ((write + 1) % size == read); }
+    bool isEmpty() { return (read == write); }
+    void queue(T k)
+    {
+        if (isFull()) {
+            read++;
+            read %= size;
+        }
+        buf[write++] = k;
+        write %= size;
+    }
+    uint16_t available() { return (write >= read) ? write - read : (size - read) + write; }
+    bool dequeue(T* c)
+    {
+        bool empty = isEmpty();
+        if (!empty) {
+            *c = buf[read++];
+            read %= size;
+        }
+        return (!empty);
+    }
+
+private:
+    volatile uint16_t write;
+    volatile uint16_t read;
+    T buf[size];
+};
+
+#define PACKET      64
+#define BYTES       (256 * 1024 * 1024)
+
+template<class F> static double mbytes_per_sec(F f)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    uint32_t sum = f();
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    // keep the copies from being optimised away
+    if (sum == 0x12345678) printf(" ");
+    return BYTES / s / 1e6;
+}
+
+// one thread moving USB sized packets through a 256 byte buffer, as the CDC endpoint and the main loop do
+static void throughput()
+{
+    static OldCircBuffer<uint8_t, 256> old_ring;
+    static RingBuffer<uint8_t, 256> ring;
+    static uint8_t packet[PACKET], out[PACKET];
+    for (int i = 0; i < PACKET; ++i) packet[i] = i;
+
+    double old_bytes = mbytes_per_sec([] {
+        uint32_t sum = 0;
+        uint8_t c;
+        for (int n = 0; n < BYTES; n += PACKET) {
+            for (int i = 0; i < PACKET; ++i) old_ring.queue(packet[i]);
+            while (old_ring.dequeue(&c)) sum += c;
+        }
+        return sum;
+    });
+
+    double new_bytes = mbytes_per_sec([] {
+        uint32_t sum = 0;
+        uint8_t c;
+        for (int n = 0; n < BYTES; n += PACKET) {
+            for (int i = 0; i < PACKET; ++i) ring.push_back(packet[i]);
+            while (ring.pop_front(c)) sum += c;
+        }
+        return sum;
+    });
+
+    double new_bulk = mbytes_per_sec([] {
+        uint32_t sum = 0;
+        for (int n = 0; n < BYTES; n += PACKET) {
+            ring.push_back(packet, PACKET);
+            size_t got = ring.pop_front(out, PACKET);
+            sum += out[got - 1];
+        }
+        return sum;
+    });
+
+    printf("throughput, %d byte packets through 256 bytes, one thread:\n", PACKET);
+    printf("  old CircBuffer per byte  %6.0f MB/s\n", old_bytes);
+    printf("  RingBuffer per byte      %6.0f MB/s\n", new_bytes);
+    printf("  RingBuffer bulk          %6.0f MB/s\n", new_bulk);
+}
+
+int main()
+{
+    bool ok = plain_spsc();
+    ok = guarded_pop_back_flush() && ok;
+    throughput();
+    return ok ? 0 : 1;
+}
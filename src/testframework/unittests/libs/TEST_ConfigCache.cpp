@@ -0,0 +1,97 @@
+#include "ConfigCache.h"
+#include "ConfigValue.h"
+#include "checksumm.h"
+#include "utils.h"
+
+#include <vector>
+#include <string>
+#include <string.h>
+
+#include "easyunit/test.h"
+
+static ConfigValue *add_value(ConfigCache& cache, const char *key, const char *value= "", int len= -1)
+{
+    uint16_t cs[3];
+    get_checksums(cs, key);
+    return cache.replace_or_push_back(cs, value, len < 0 ? strlen(value) : len);
+}
+
+static ConfigValue *find(ConfigCache& cache, const char *key)
+{
+    uint16_t cs[3];
+    get_checksums(cs, key);
+    return cache.lookup(cs);
+}
+
+TEST(ConfigCache,lookup)
+{
+    ConfigCache cache;
+    const char *keys[]= {"alpha_steps_per_mm", "beta_steps_per_mm", "gamma_steps_per_mm", "extruder.hotend.enable", "extruder.hotend.steps_per_mm", "uart0.baud_rate"};
+    std::vector<ConfigValue*> values;
+    for(auto k : keys) {
+        values.push_back(add_value(cache, k));
+    }
+
+    // works before and after the index is built
+    for (size_t i = 0; i < values.size(); ++i) {
+        ASSERT_TRUE(find(cache, keys[i]) == values[i]);
+    }
+    cache.build_index();
+    for (size_t i = 0; i < values.size(); ++i) {
+        ASSERT_TRUE(find(cache, keys[i]) == values[i]);
+    }
+
+    ASSERT_TRUE(find(cache, "delta_steps_per_mm") == NULL);
+    ASSERT_TRUE(find(cache, "extruder.hotend") == NULL);
+}
+
+TEST(ConfigCache,duplicates_last_one_wins)
+{
+    ConfigCache cache;
+    add_value(cache, "alpha_steps_per_mm");
+    add_value(cache, "beta_steps_per_mm");
+    ConfigValue *last= add_value(cache, "alpha_steps_per_mm");
+
+    ASSERT_TRUE(find(cache, "alpha_steps_per_mm") == last);
+    cache.build_index();
+    ASSERT_TRUE(find(cache, "alpha_steps_per_mm") == last);
+
+    // replacing once indexed
+    ConfigValue *replaced= add_value(cache, "beta_steps_per_mm");
+    ASSERT_TRUE(find(cache, "beta_steps_per_mm") == replaced);
+}
+
+TEST(ConfigCache,collect_keeps_config_order)
+{
+    ConfigCache cache;
+    const char *keys[]= {"temperature_control.hotend.enable", "switch.fan.enable", "temperature_control.bed.enable",
+                         "temperature_control.hotend.sensor", "temperature_control.hotend2.enable", "temperature_control.bed.enable"};
+    for(auto k : keys) {
+        add_value(cache, k);
+    }
+    cache.build_index();
+
+    std::vector<uint16_t> list;
+    cache.collect(CHECKSUM("temperature_control"), CHECKSUM("enable"), &list);
+    ASSERT_EQUALS_V(3, (int)list.size());
+    ASSERT_TRUE(list[0] == CHECKSUM("hotend"));
+    ASSERT_TRUE(list[1] == CHECKSUM("bed"));
+    ASSERT_TRUE(list[2] == CHECKSUM("hotend2"));
+
+    list.clear();
+    cache.collect(CHECKSUM("switch"), CHECKSUM("enable"), &list);
+    ASSERT_EQUALS_V(1, (int)list.size());
+    ASSERT_TRUE(list[0] == CHECKSUM("fan"));
+}
+
+TEST(ConfigCache,values_copied_to_arena)
+{
+    ConfigCache cache;
+    ConfigValue *a= add_value(cache, "alpha_en_pin", "0.10");
+    ConfigValue *b= add_value(cache, "beta_en_pin", "0.10!");
+    ConfigValue *c= add_value(cache, "gamma_en_pin", "0.10 extra", 4);
+
+    ASSERT_TRUE(a->as_string() == "0.10");
+    ASSERT_TRUE(b->as_string() == "0.10!");
+    ASSERT_TRUE(c->as_string() == "0.10");
+}
@@ -0,0 +1,61 @@
+#include "HeatshrinkDecoder.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#include "easyunit/test.h"
+
+// "G1 X10 Y10\nG1 X10 Y20\nG1 X10 Y30\nG1 X10 Y40\n" compressed with heatshrink -w 8 -l 4
+static const uint8_t compressed[]= {
+    0xA3, 0xCC, 0x64, 0x15, 0x89, 0x8C, 0xC2, 0x41, 0x59, 0x01, 0x8C, 0x28,
+    0x14, 0xF3, 0x20, 0x54, 0xCC, 0xC1, 0x53, 0x34, 0x05, 0x08
+};
+static const char *expected= "G1 X10 Y10\nG1 X10 Y20\nG1 X10 Y30\nG1 X10 Y40\n";
+
+TEST(HeatshrinkDecoder,decode_all)
+{
+    uint8_t window[256];
+    HeatshrinkDecoder d(window, 8, 4);
+
+    uint8_t out[128];
+    size_t used;
+    size_t n= d.decode(compressed, sizeof(compressed), used, out, sizeof(out));
+    ASSERT_EQUALS_V((int)strlen(expected), (int)n);
+    ASSERT_EQUALS_V((int)sizeof(compressed), (int)used);
+    ASSERT_TRUE(memcmp(out, expected, n) == 0);
+}
+
+TEST(HeatshrinkDecoder,decode_byte_at_a_time)
+{
+    uint8_t window[256];
+    HeatshrinkDecoder d(window, 8, 4);
+
+    // feed one byte in and take at most one byte out per call, so literals and back references get split
+    std::string result;
+    size_t pos= 0;
+    while(true) {
+        uint8_t c;
+        size_t used;
+        size_t n= d.decode(&compressed[pos], pos < sizeof(compressed) ? 1 : 0, used, &c, 1);
+        pos += used;
+        if(n == 1) result.push_back(c);
+        else if(pos >= sizeof(compressed)) break;
+    }
+
+    ASSERT_TRUE(result == expected);
+}
+
+TEST(HeatshrinkDecoder,reset)
+{
+    uint8_t window[256];
+    HeatshrinkDecoder d(window, 8, 4);
+
+    uint8_t out[128];
+    size_t used;
+    d.decode(compressed, 10, used, out, sizeof(out));
+    d.reset();
+    size_t n= d.decode(compressed, sizeof(compressed), used, out, sizeof(out));
+    ASSERT_EQUALS_V((int)strlen(expected), (int)n);
+    ASSERT_TRUE(memcmp(out, expected, n) == 0);
+}
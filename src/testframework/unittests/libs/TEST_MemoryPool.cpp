@@ -0,0 +1,93 @@
+#include "MemoryPool.h"
+
+#include <stdint.h>
+
+#include "easyunit/test.h"
+
+static uint32_t pool_memory[4096 / 4];
+
+TEST(MemoryPool,small_allocations_reuse_slab)
+{
+    MemoryPool pool(pool_memory, sizeof(pool_memory));
+    uint32_t initial= pool.free();
+
+    void *a= pool.alloc(10);
+    void *b= pool.alloc(12);
+    ASSERT_TRUE(a != NULL && b != NULL && a != b);
+    ASSERT_TRUE(pool.has(a) && pool.has(b));
+
+    // freed objects go back to their class and are handed out again first
+    pool.dealloc(a);
+    void *c= pool.alloc(16);
+    ASSERT_TRUE(c == a);
+
+    pool.dealloc(b);
+    pool.dealloc(c);
+    // the slab stays with its class, but its objects count as free
+    uint32_t after= pool.free();
+    ASSERT_TRUE(after <= initial);
+    ASSERT_TRUE(initial - after < 256);
+}
+
+TEST(MemoryPool,classes_are_separate)
+{
+    MemoryPool pool(pool_memory, sizeof(pool_memory));
+
+    void *s= pool.alloc(8);
+    void *m= pool.alloc(100);
+    pool.dealloc(s);
+    void *m2= pool.alloc(100);
+    ASSERT_TRUE(m2 != s);
+    pool.dealloc(m);
+    pool.dealloc(m2);
+}
+
+TEST(MemoryPool,large_allocations_use_region)
+{
+    MemoryPool pool(pool_memory, sizeof(pool_memory));
+    uint32_t initial= pool.free();
+
+    void *a= pool.alloc(1000);
+    void *b= pool.alloc(1000);
+    ASSERT_TRUE(a != NULL && b != NULL);
+    pool.dealloc(a);
+    pool.dealloc(b);
+
+    // coalesced back into one free region
+    ASSERT_TRUE(pool.free() == initial);
+    ASSERT_TRUE(pool.alloc(3000) != NULL);
+}
+
+TEST(MemoryPool,exhaustion)
+{
+    MemoryPool pool(pool_memory, sizeof(pool_memory));
+
+    int n= 0;
+    void *p;
+    while((p= pool.alloc(60)) != NULL) {
+        ASSERT_TRUE(pool.has(p));
+        n++;
+    }
+    // 64 byte objects with a 4 byte header, less what the slab rounding leaves over
+    ASSERT_TRUE(n > 50);
+    ASSERT_TRUE(n <= 4096 / 68);
+}
+
+TEST(MemoryPool,empty_slabs_go_back_to_region)
+{
+    MemoryPool pool(pool_memory, sizeof(pool_memory));
+    uint32_t initial= pool.free();
+
+    void *p[100];
+    for (int i = 0; i < 100; ++i) {
+        p[i]= pool.alloc(20);
+        ASSERT_TRUE(p[i] != NULL);
+    }
+    for (int i = 0; i < 100; ++i) {
+        pool.dealloc(p[i]);
+    }
+
+    // only the one slab kept by the class is still carved out
+    ASSERT_TRUE(initial - pool.free() < 256);
+    ASSERT_TRUE(pool.alloc(2000) != NULL);
+}
@@ -0,0 +1,90 @@
+#include "RingBuffer.h"
+
+#include <string.h>
+
+#include "easyunit/test.h"
+
+TEST(RingBuffer,push_pop)
+{
+    RingBuffer<int, 4> rb;
+    ASSERT_TRUE(rb.empty());
+    ASSERT_EQUALS_V(4, (int)rb.capacity());
+
+    // whole capacity is usable
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(rb.push_back(i));
+    }
+    ASSERT_TRUE(rb.full());
+    ASSERT_TRUE(!rb.push_back(99));
+
+    int v;
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(rb.pop_front(v));
+        ASSERT_EQUALS_V(i, v);
+    }
+    ASSERT_TRUE(rb.empty());
+    ASSERT_TRUE(!rb.pop_front(v));
+}
+
+TEST(RingBuffer,wraps)
+{
+    RingBuffer<int, 8> rb;
+    int v;
+    // go round many times so the free running indices pass the end of the buffer
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_TRUE(rb.push_back(i));
+        ASSERT_TRUE(rb.push_back(i + 1000));
+        ASSERT_EQUALS_V(2, (int)rb.size());
+        ASSERT_EQUALS_V(i + 1000, rb.peek(1));
+        ASSERT_TRUE(rb.pop_front(v));
+        ASSERT_EQUALS_V(i, v);
+        ASSERT_TRUE(rb.pop_front(v));
+        ASSERT_EQUALS_V(i + 1000, v);
+    }
+}
+
+TEST(RingBuffer,bulk)
+{
+    RingBuffer<char, 16> rb;
+    const char *s= "0123456789abcdefghij";
+
+    // partial pushes and pops across the wrap
+    int n= rb.push_back(s, 10);
+    ASSERT_EQUALS_V(10, n);
+    char out[20];
+    n= rb.pop_front(out, 6);
+    ASSERT_EQUALS_V(6, n);
+    ASSERT_TRUE(memcmp(out, s, 6) == 0);
+
+    n= rb.push_back(s + 10, 10);
+    ASSERT_EQUALS_V(10, n);
+    n= rb.push_back(s, 20); // only 2 more fit
+    ASSERT_EQUALS_V(2, n);
+    ASSERT_TRUE(rb.full());
+
+    n= rb.pop_front(out, 20);
+    ASSERT_EQUALS_V(16, n);
+    ASSERT_TRUE(memcmp(out, s + 6, 14) == 0);
+    ASSERT_TRUE(memcmp(out + 14, s, 2) == 0);
+    ASSERT_TRUE(rb.empty());
+}
+
+TEST(RingBuffer,pop_back_discard_flush)
+{
+    RingBuffer<char, 8> rb;
+    rb.push_back("abcd", 4);
+
+    ASSERT_TRUE(rb.pop_back());
+    ASSERT_EQUALS_V(3, (int)rb.size());
+    ASSERT_EQUALS_V('c', rb.peek(2));
+
+    int n= rb.discard();
+    ASSERT_EQUALS_V(1, n);
+    ASSERT_EQUALS_V('b', rb.peek(0));
+
+    rb.flush();
+    ASSERT_TRUE(rb.empty());
+    ASSERT_TRUE(!rb.pop_back());
+    n= rb.discard(5);
+    ASSERT_EQUALS_V(0, n);
+}
@@ -0,0 +1,74 @@
+#include "SerialLineBuffer.h"
+
+#include <string>
+
+#include "easyunit/test.h"
+
+static void receive(SerialLineBuffer<16>& b, const char *s)
+{
+    while(*s) b.receive(*s++);
+}
+
+TEST(SerialLineBuffer,lines)
+{
+    SerialLineBuffer<16> b;
+    std::string line;
+    ASSERT_TRUE(!b.get_line(line));
+
+    receive(b, "G1 X1\nM10");
+    ASSERT_TRUE(b.get_line(line));
+    ASSERT_TRUE(line == "G1 X1");
+    ASSERT_TRUE(!b.get_line(line));
+
+    receive(b, "5\n");
+    ASSERT_TRUE(b.get_line(line));
+    ASSERT_TRUE(line == "M105");
+}
+
+TEST(SerialLineBuffer,overflow_recovers)
+{
+    SerialLineBuffer<16> b;
+    std::string line;
+
+    // too long to ever fit, with no newline in the buffer the main loop could wait for one forever. the line after it
+    // arrives before the main loop has thrown the start of it away
+    receive(b, "G1 X1234567890 Y1234567890 Z1234567890 E123\nM105\n");
+    ASSERT_TRUE(!b.get_line(line));
+
+    // the rest of the long line goes too, and the line after it gets through whole
+    receive(b, "G1 Y2 E3\nG4 P0\n");
+    ASSERT_TRUE(b.get_line(line));
+    ASSERT_TRUE(line == "G1 Y2 E3");
+    ASSERT_TRUE(b.get_line(line));
+    ASSERT_TRUE(line == "G4 P0");
+    ASSERT_TRUE(!b.get_line(line));
+
+    // the main loop throwing the start away while the long line is still arriving
+    receive(b, "G1 X1234567890 Y1234567890");
+    ASSERT_TRUE(!b.get_line(line));
+    receive(b, " Z1234567890\nM105\n");
+    ASSERT_TRUE(b.get_line(line));
+    ASSERT_TRUE(line == "M105");
+}
+
+TEST(SerialLineBuffer,overflow_behind_whole_lines)
+{
+    SerialLineBuffer<16> b;
+    std::string line;
+
+    // whole lines queued ahead of one that does not fit are still delivered, and the broken one is never joined to the next
+    receive(b, "M105\nG1 X1234567890123\nM114\n");
+    ASSERT_TRUE(b.get_line(line));
+    ASSERT_TRUE(line == "M105");
+    ASSERT_TRUE(!b.get_line(line));
+    receive(b, "M115\n");
+    ASSERT_TRUE(b.get_line(line));
+    ASSERT_TRUE(line == "M115");
+
+    // the newline itself not fitting
+    receive(b, "G1 X123456789ABC\nM400\n");
+    ASSERT_TRUE(!b.get_line(line));
+    receive(b, "M401\n");
+    ASSERT_TRUE(b.get_line(line));
+    ASSERT_TRUE(line == "M401");
+}
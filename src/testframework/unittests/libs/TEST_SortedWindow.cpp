@@ -0,0 +1,59 @@
+#include "SortedWindow.h"
+
+#include <stdlib.h>
+#include <algorithm>
+
+#include "easyunit/test.h"
+
+TEST(SortedWindow,starts_empty)
+{
+    SortedWindow<8> w;
+    ASSERT_EQUALS_V(0, (int)w.median());
+    ASSERT_EQUALS_V(0, (int)w.trimmed_sum());
+
+    // half the window is needed before the spikes stop being trimmed away
+    for (int i = 0; i < 4; ++i) w.put(100);
+    ASSERT_EQUALS_V(100, (int)w.median());
+    uint32_t sum= w.trimmed_sum();
+    ASSERT_EQUALS_V(200, (int)sum);
+}
+
+TEST(SortedWindow,matches_sorting)
+{
+    SortedWindow<32> w;
+    uint16_t history[32]= {0};
+    srand(1);
+
+    for (int n = 0; n < 2000; ++n) {
+        // a noisy level that wanders about with the odd spike, so duplicates and big jumps both happen
+        uint16_t v= 2000 + (n % 300) + (rand() % 8);
+        if(rand() % 50 == 0) v= rand() % 4096;
+        w.put(v);
+        history[n % 32]= v;
+
+        uint16_t sorted[32];
+        std::copy(history, history + 32, sorted);
+        std::sort(sorted, sorted + 32);
+        uint32_t sum= 0;
+        for (int i = 8; i < 24; ++i) sum += sorted[i];
+
+        for (int i = 0; i < 32; ++i) {
+            ASSERT_TRUE(w[i] == sorted[i]);
+        }
+        ASSERT_TRUE(w.median() == sorted[16]);
+        ASSERT_TRUE(w.trimmed_sum() == sum);
+    }
+}
+
+TEST(SortedWindow,spikes_are_trimmed)
+{
+    SortedWindow<8> w;
+    for (int i = 0; i < 8; ++i) w.put(1000);
+    w.put(4095);
+    w.put(0);
+    uint32_t sum= w.trimmed_sum();
+    ASSERT_EQUALS_V(4000, (int)sum);
+
+    w.clear();
+    ASSERT_EQUALS_V(0, (int)w.median());
+}
@@ -60,3 +60,34 @@ TEST(GCodeTest,subcode)
     ASSERT_EQUALS_DELTA_V(2.3, gc4.get_value('Y'), 0.001);
 
 }
+
+TEST(GCodeTest,shared_command)
+{
+    Gcode gc1("G1 X1 Y2 F100", nullptr);
+    Gcode gc2(gc1);
+    // copies share the command text
+    ASSERT_TRUE(gc1.get_command() == gc2.get_command());
+
+    // changing one leaves the other alone
+    gc1.strip_parameters();
+    ASSERT_TRUE(gc1.get_command() != gc2.get_command());
+    ASSERT_TRUE(!gc1.has_letter('X'));
+    ASSERT_TRUE(gc2.has_letter('X'));
+    ASSERT_EQUALS_DELTA_V(100, gc1.get_value('F'), 0.001);
+    ASSERT_EQUALS_DELTA_V(2.0, gc2.get_value('Y'), 0.001);
+}
+
+TEST(GCodeTest,pooled_new)
+{
+    // more than the pool holds so some come from the heap
+    std::vector<Gcode*> v;
+    for (int i = 0; i < 10; ++i) {
+        v.push_back(new Gcode("M114", nullptr));
+        ASSERT_EQUALS_V(114, v.back()->m);
+    }
+    for(auto g : v) delete g;
+
+    Gcode *g= new Gcode("G0 X1", nullptr);
+    ASSERT_EQUALS_DELTA_V(1.0, g->get_value('X'), 0.001);
+    delete g;
+}
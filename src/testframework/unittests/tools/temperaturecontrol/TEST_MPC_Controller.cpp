@@ -0,0 +1,119 @@
+#include "MPC_Controller.h"
+
+#include <math.h>
+
+#include "easyunit/test.h"
+
+// a heater block with a true dead time on its input and a slight lag on the sensor
+struct plant_t {
+    float gain, time_constant, ambient, fan_loss;
+    float block, sensor, fan;
+    float delayed[80];
+    int n, pos;
+
+    plant_t(float g, float tc, int delay_steps) : gain(g), time_constant(tc), ambient(22), fan_loss(0.5F), block(22), sensor(22), fan(0), n(delay_steps), pos(0)
+    {
+        for (int i = 0; i < n; ++i) delayed[i]= 0;
+    }
+
+    float step(float duty, float dt)
+    {
+        float d= delayed[pos];
+        delayed[pos]= duty;
+        pos= (pos + 1) % n;
+        block += (dt / time_constant) * (gain * d - (1 + fan_loss * fan) * (block - ambient));
+        sensor += (dt / 1.0F) * (block - sensor);
+        return sensor;
+    }
+};
+
+TEST(MPC_Controller,fit_relay_cycle)
+{
+    // make up the cycle an exact model would give and check we get the model back
+    float gain= 800, tc= 150, dead= 4;
+    float off= 181, on= 179, e= expf(-dead / tc);
+    float trough= on * e;
+    float peak= gain - (gain - off) * e;
+    float cool= dead + tc * logf(peak / on);
+
+    MPC_Controller mpc;
+    ASSERT_TRUE(mpc.fit_relay_cycle(off, on, peak, trough, cool, 1.0F));
+    ASSERT_TRUE(fabsf(mpc.gain - gain) < 1);
+    ASSERT_TRUE(fabsf(mpc.time_constant - tc) < 0.5F);
+    ASSERT_TRUE(fabsf(mpc.dead_time - dead) < 0.05F);
+
+    float heat= dead + tc * logf((gain - trough) / (gain - off));
+    ASSERT_TRUE(fabsf(mpc.predicted_heat_time(off, trough, 1.0F) - heat) < 0.1F);
+
+    // nonsense is rejected and leaves the model alone
+    ASSERT_TRUE(!mpc.fit_relay_cycle(off, on, peak, on + 1, cool, 1.0F));
+    ASSERT_TRUE(fabsf(mpc.gain - gain) < 1);
+}
+
+TEST(MPC_Controller,heats_without_overshoot)
+{
+    const float dt= 0.05F;
+    plant_t plant(1000, 150, 80); // 4 seconds of dead time
+
+    // a model that is a little off, as a fit would be
+    MPC_Controller mpc;
+    mpc.gain= 1080;
+    mpc.time_constant= 165;
+    mpc.dead_time= 5;
+    mpc.horizon= 5;
+    mpc.ambient= 25;
+    mpc.fan_loss= 0.5F;
+    mpc.reset(plant.sensor, 0);
+
+    float t= plant.sensor, peak= 0;
+    for (int i = 0; i < 200 / dt; ++i) {
+        t= plant.step(mpc.update(230, t, dt), dt);
+        if(t > peak) peak= t;
+    }
+    ASSERT_TRUE(peak < 231.5F);
+    ASSERT_TRUE(fabsf(t - 230) < 0.5F);
+
+    // the fan coming on is fed forward and the rest is taken up by the disturbance
+    plant.fan= 1;
+    mpc.set_load(1, 0);
+    float low= t;
+    for (int i = 0; i < 200 / dt; ++i) {
+        t= plant.step(mpc.update(230, t, dt), dt);
+        if(t < low) low= t;
+    }
+    ASSERT_TRUE(low > 226);
+    ASSERT_TRUE(fabsf(t - 230) < 0.5F);
+}
+
+TEST(MPC_Controller,pid_gains)
+{
+    const float dt= 0.05F;
+    plant_t plant(1000, 150, 80);
+
+    MPC_Controller mpc;
+    mpc.gain= 1080;
+    mpc.time_constant= 165;
+    mpc.dead_time= 5;
+    mpc.ambient= 25;
+
+    float kp, ki, kd;
+    mpc.pid_gains(255, mpc.dead_time, kp, ki, kd);
+    ASSERT_TRUE(kp > 0 && ki > 0 && kd > 0);
+
+    // run it the way TemperatureControl does, the integral keeps going while the output is saturated and is only held
+    // back by i_max, which the autotuner sets to twice what holding the target takes
+    float i_max= 2 * (230 - mpc.ambient) * 255 / mpc.gain;
+    float t= plant.sensor, last= t, iterm= 0, peak= 0;
+    for (int i = 0; i < 300 / dt; ++i) {
+        float error= 230 - t;
+        iterm += error * ki * dt;
+        if(iterm > i_max) iterm= i_max; else if(iterm < 0) iterm= 0;
+        float o= kp * error + iterm - (kd / dt) * (t - last);
+        if(o > 255) o= 255; else if(o < 0) o= 0;
+        last= t;
+        t= plant.step(o / 255, dt);
+        if(t > peak) peak= t;
+    }
+    ASSERT_TRUE(peak < 240);
+    ASSERT_TRUE(fabsf(t - 230) < 0.5F);
+}
@@ -0,0 +1,68 @@
+#include "ThermistorTable.h"
+
+#include <math.h>
+
+#include "easyunit/test.h"
+
+// a 100k beta 4066 thermistor with a 4k7 pullup on the 14 bit oversampled ADC
+static const uint32_t max_adc= 4095 << 2;
+static float beta_temperature(uint32_t adc)
+{
+    float r= 4700 / (((float)max_adc / adc) - 1.0F);
+    return (1.0F / ((1.0F / (25 + 273.15F)) + (logf(r / 100000) / 4066))) - 273.15F;
+}
+
+TEST(ThermistorTable,within_tolerance)
+{
+    ThermistorTable table;
+    int evaluations= 0;
+    auto counted= [&evaluations](uint32_t adc) { ++evaluations; return beta_temperature(adc); };
+    ASSERT_TRUE(table.build(counted, max_adc, 0, 400, 0.1F));
+    ASSERT_TRUE(table.size() > 2 && table.size() <= 64);
+    // far fewer than one per reading
+    ASSERT_TRUE(evaluations < (int)max_adc / 2);
+
+    // the rounding of lookup() is part of the tolerance
+    ASSERT_TRUE(table.get_max_error() <= 0.1F);
+    for (uint32_t adc = 1; adc < max_adc; ++adc) {
+        float exact= beta_temperature(adc);
+        float t;
+        if(table.lookup(adc, t)) {
+            ASSERT_TRUE(fabsf(t - exact) <= table.get_max_error());
+        }else{
+            // only readings outside the tabulated range are left to be calculated
+            ASSERT_TRUE(exact < 0.1F || exact > 399.9F);
+        }
+    }
+
+    // no room left for the segments once lookup() has rounded
+    ASSERT_TRUE(!table.build(beta_temperature, max_adc, 0, 400, 0.5F / 32));
+}
+
+TEST(ThermistorTable,looser_tolerance_fewer_points)
+{
+    ThermistorTable fine, coarse;
+    fine.build(beta_temperature, max_adc, 0, 300, 0.05F);
+    coarse.build(beta_temperature, max_adc, 0, 300, 0.5F);
+    ASSERT_TRUE(coarse.size() < fine.size());
+    ASSERT_TRUE(coarse.get_max_error() <= 0.5F);
+
+    coarse.clear();
+    float t;
+    ASSERT_TRUE(coarse.empty());
+    ASSERT_TRUE(!coarse.lookup(1000, t));
+}
+
+TEST(ThermistorTable,rising_curve)
+{
+    // eg a sensor that reads higher as it gets hotter
+    auto linear= [](uint32_t adc) { return adc * 0.05F - 20; };
+    ThermistorTable table;
+    ASSERT_TRUE(table.build(linear, max_adc, 0, 500, 0.1F));
+    // a straight line needs just the two ends
+    ASSERT_EQUALS_V(2, (int)table.size());
+    float t;
+    ASSERT_TRUE(table.lookup(2400, t));
+    ASSERT_TRUE(fabsf(t - 100) < 0.05F);
+    ASSERT_TRUE(!table.lookup(100, t));
+}
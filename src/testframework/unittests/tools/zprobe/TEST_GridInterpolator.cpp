@@ -0,0 +1,293 @@
+#include "GridInterpolator.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+#include <algorithm>
+
+#include "easyunit/test.h"
+
+// what CartGridStrategy::doCompensation used to do for every point
+static float reference_offset(const float *grid, int nx, int ny, float x_start, float y_start, float x_size, float y_size, float x, float y)
+{
+    float min_x = std::min(x_start, x_start + x_size);
+    float max_x = std::max(x_start, x_start + x_size);
+    float min_y = std::min(y_start, y_start + y_size);
+    float max_y = std::max(y_start, y_start + y_size);
+    float x_target = std::min(std::max(x, min_x), max_x);
+    float y_target = std::min(std::max(y, min_y), max_y);
+    float grid_x = std::max(0.001F, std::min(nx - 1.001F, (x_target - x_start) / (x_size / (nx - 1))));
+    float grid_y = std::max(0.001F, std::min(ny - 1.001F, (y_target - y_start) / (y_size / (ny - 1))));
+    int floor_x = floorf(grid_x);
+    int floor_y = floorf(grid_y);
+    float ratio_x = grid_x - floor_x;
+    float ratio_y = grid_y - floor_y;
+    float z1 = grid[(floor_x) + ((floor_y) * nx)];
+    float z2 = grid[(floor_x) + ((floor_y + 1) * nx)];
+    float z3 = grid[(floor_x + 1) + ((floor_y) * nx)];
+    float z4 = grid[(floor_x + 1) + ((floor_y + 1) * nx)];
+    float left = (1 - ratio_y) * z1 + ratio_y * z2;
+    float right = (1 - ratio_y) * z3 + ratio_y * z4;
+    return (1 - ratio_x) * left + ratio_x * right;
+}
+
+static void make_grid(float *grid, int nx, int ny)
+{
+    for (int y = 0; y < ny; ++y) {
+        for (int x = 0; x < nx; ++x) {
+            grid[x + y * nx]= 0.2F * sinf(x * 0.7F) * cosf(y * 0.5F) + 0.01F * x;
+        }
+    }
+}
+
+TEST(GridInterpolator,matches_bilinear)
+{
+    const int nx= 7, ny= 5;
+    float grid[nx * ny];
+    make_grid(grid, nx, ny);
+
+    GridInterpolator gi;
+    ASSERT_TRUE(!gi.is_set());
+    gi.set_grid(grid, nx, ny, 10, 20, 200.0F / (nx - 1), 150.0F / (ny - 1));
+    ASSERT_TRUE(gi.is_set());
+
+    // including points off the grid on every side, which get the nearest edge
+    for (float y = 0; y < 190; y += 3.7F) {
+        for (float x = -5; x < 230; x += 4.3F) {
+            float a= gi.get_offset(x, y);
+            float b= reference_offset(grid, nx, ny, 10, 20, 200, 150, x, y);
+            ASSERT_TRUE(fabsf(a - b) < 1e-5F);
+        }
+    }
+
+    // a grid probed from the far corner has negative sizes
+    gi.set_grid(grid, nx, ny, 210, 170, -200.0F / (nx - 1), -150.0F / (ny - 1));
+    for (float y = 0; y < 190; y += 3.7F) {
+        for (float x = -5; x < 230; x += 4.3F) {
+            float a= gi.get_offset(x, y);
+            float b= reference_offset(grid, nx, ny, 210, 170, -200, -150, x, y);
+            ASSERT_TRUE(fabsf(a - b) < 1e-5F);
+        }
+    }
+}
+
+TEST(GridInterpolator,follows_grid_changes)
+{
+    float grid[9]= {0, 0, 0, 0, 0, 0, 0, 0, 0};
+    GridInterpolator gi;
+    gi.set_grid(grid, 3, 3, 0, 0, 10, 10);
+    ASSERT_TRUE(fabsf(gi.get_offset(5, 5)) < 1e-6F);
+
+    // the cached cell has to be dropped when the grid is set again
+    for (int i = 0; i < 9; ++i) grid[i]= 1;
+    gi.set_grid(grid, 3, 3, 0, 0, 10, 10);
+    ASSERT_TRUE(fabsf(gi.get_offset(5, 5) - 1) < 1e-6F);
+
+    // an unprobed point shows up as NaN
+    grid[4]= NAN;
+    gi.set_grid(grid, 3, 3, 0, 0, 10, 10);
+    ASSERT_TRUE(isnan(gi.get_offset(5, 5)));
+    ASSERT_TRUE(isnan(gi.get_offset(15, 15)));
+
+    gi.clear();
+    ASSERT_TRUE(!gi.is_set());
+}
+
+// a toolpath chopped into short segments like Robot::append_line does, every endpoint is compensated and most of them
+// fall in the same cell as the one before
+TEST(GridInterpolator,segmented_toolpath_benchmark)
+{
+    const int nx= 9, ny= 9;
+    float grid[nx * ny];
+    make_grid(grid, nx, ny);
+    GridInterpolator gi;
+    gi.set_grid(grid, nx, ny, 0, 0, 250.0F / (nx - 1), 250.0F / (ny - 1));
+
+    // a zig zag infill over the bed at 0.5mm segments
+    const float seg= 0.5F;
+    int points= 0;
+    float sum_a= 0, sum_b= 0;
+    clock_t ta= 0, tb= 0;
+    for (int pass = 0; pass < 5; ++pass) {
+        for (float y = 5; y < 245; y += 2) {
+            clock_t t0= clock();
+            for (float x = 5; x < 245; x += seg) sum_a += gi.get_offset(x, y);
+            clock_t t1= clock();
+            for (float x = 5; x < 245; x += seg) sum_b += reference_offset(grid, nx, ny, 0, 0, 250, 250, x, y);
+            clock_t t2= clock();
+            ta += t1 - t0;
+            tb += t2 - t1;
+            if(pass == 0) points += (int)((245 - 5) / seg);
+        }
+    }
+    ASSERT_TRUE(fabsf(sum_a - sum_b) < 1e-2F);
+
+    printf("GridInterpolator: %d points, cached %1.1fns/point, uncached %1.1fns/point\n", points,
+        (double)ta * 1e9 / CLOCKS_PER_SEC / (points * 5), (double)tb * 1e9 / CLOCKS_PER_SEC / (points * 5));
+}
+
+TEST(GridInterpolator,bicubic_through_points)
+{
+    const int nx= 6, ny= 4;
+    float grid[nx * ny];
+    make_grid(grid, nx, ny);
+    float coeffs[GridInterpolator::bicubic_size(nx, ny)];
+
+    GridInterpolator gi;
+    gi.set_grid(grid, nx, ny, 0, 0, 20, 30, coeffs);
+    ASSERT_TRUE(gi.is_bicubic());
+
+    // it passes through every grid point
+    for (int y = 0; y < ny; ++y) {
+        for (int x = 0; x < nx; ++x) {
+            ASSERT_TRUE(fabsf(gi.get_offset(x * 20, y * 30) - grid[x + y * nx]) < 1e-3F);
+        }
+    }
+
+    // and a tilted bed stays flat, right out to the edges
+    for (int y = 0; y < ny; ++y) {
+        for (int x = 0; x < nx; ++x) {
+            grid[x + y * nx]= 0.1F + 0.02F * x - 0.03F * y;
+        }
+    }
+    gi.set_grid(grid, nx, ny, 0, 0, 20, 30, coeffs);
+    for (float y = 0; y <= 90; y += 2.9F) {
+        for (float x = 0; x <= 100; x += 3.1F) {
+            float expect= 0.1F + 0.02F * x / 20 - 0.03F * y / 30;
+            ASSERT_TRUE(fabsf(gi.get_offset(x, y) - expect) < 1e-4F);
+        }
+    }
+
+    gi.set_grid(grid, nx, ny, 0, 0, 20, 30);
+    ASSERT_TRUE(!gi.is_bicubic());
+}
+
+// a fixture plate bowed in the middle and twisted across the corners, 250mm square
+static float warped_bed(float x, float y)
+{
+    float u= x / 250 - 0.5F, v= y / 250 - 0.5F;
+    return 0.3F * cosf(3.0F * u) * cosf(2.6F * v) + 0.25F * u * v + 0.05F * sinf(5.0F * u + 1);
+}
+
+static float worst_error(int n, bool bicubic, double& ns)
+{
+    float grid[n * n];
+    float coeffs[GridInterpolator::bicubic_size(n, n)];
+    float d= 250.0F / (n - 1);
+    for (int y = 0; y < n; ++y) {
+        for (int x = 0; x < n; ++x) {
+            grid[x + y * n]= warped_bed(x * d, y * d);
+        }
+    }
+    GridInterpolator gi;
+    gi.set_grid(grid, n, n, 0, 0, d, d, bicubic ? coeffs : nullptr);
+
+    float worst= 0;
+    for (float y = 0; y <= 250; y += 1.3F) {
+        for (float x = 0; x <= 250; x += 1.1F) {
+            worst= std::max(worst, fabsf(gi.get_offset(x, y) - warped_bed(x, y)));
+        }
+    }
+
+    // the cost of a point on a 0.5mm segmented path, as in the benchmark above
+    int points= 0;
+    float sum= 0;
+    clock_t t0= clock();
+    for (int pass = 0; pass < 5; ++pass) {
+        for (float y = 5; y < 245; y += 2) {
+            for (float x = 5; x < 245; x += 0.5F) {
+                sum += gi.get_offset(x, y);
+                ++points;
+            }
+        }
+    }
+    ns= (double)(clock() - t0) * 1e9 / CLOCKS_PER_SEC / points;
+    return isnan(sum) ? NAN : worst;
+}
+
+TEST(GridInterpolator,bicubic_accuracy_benchmark)
+{
+    double ns_l5, ns_c5, ns_l9;
+    float bilinear5= worst_error(5, false, ns_l5);
+    float bicubic5= worst_error(5, true, ns_c5);
+    float bilinear9= worst_error(9, false, ns_l9);
+
+    printf("GridInterpolator: worst error 5x5 bilinear %1.4fmm (%1.1fns/point), 5x5 bicubic %1.4fmm (%1.1fns/point), 9x9 bilinear %1.4fmm (%1.1fns/point)\n",
+        bilinear5, ns_l5, bicubic5, ns_c5, bilinear9, ns_l9);
+
+    // a 5x5 bicubic grid does at least as well as bilinear with more than three times the probe points
+    ASSERT_TRUE(bicubic5 < bilinear5 / 2);
+    ASSERT_TRUE(bicubic5 <= bilinear9);
+}
+
+// the worst difference along the line between the surface and straight pieces through the offsets at the breaks
+static float worst_chord_error(GridInterpolator& gi, float xa, float ya, float xb, float yb, const float *t, int n)
+{
+    float worst= 0;
+    float ta= 0, za= gi.get_offset(xa, ya);
+    for (int i = 0; i <= n; ++i) {
+        float tb= (i < n) ? t[i] : 1;
+        float zb= gi.get_offset(xa + (xb - xa) * tb, ya + (yb - ya) * tb);
+        for (int j = 1; j < 50; ++j) {
+            float f= j / 50.0F, tj= ta + (tb - ta) * f;
+            float z= gi.get_offset(xa + (xb - xa) * tj, ya + (yb - ya) * tj);
+            worst= std::max(worst, fabsf(z - (za + (zb - za) * f)));
+        }
+        ta= tb;
+        za= zb;
+    }
+    return worst;
+}
+
+TEST(GridInterpolator,split_line)
+{
+    const int nx= 5, ny= 5;
+    float grid[nx * ny];
+    for (int y = 0; y < ny; ++y) {
+        for (int x = 0; x < nx; ++x) {
+            grid[x + y * nx]= warped_bed(x * 62.5F, y * 62.5F);
+        }
+    }
+    float coeffs[GridInterpolator::bicubic_size(nx, ny)];
+    GridInterpolator gi;
+    float t[64];
+
+    // along a grid row a bilinear offset is straight inside each cell, so it only breaks at the three inner lines
+    gi.set_grid(grid, nx, ny, 0, 0, 62.5F, 62.5F);
+    int n= gi.split_line(-10, 62.5F, 260, 62.5F, 0.001F, t, 64);
+    ASSERT_TRUE(n == 5);
+    ASSERT_TRUE(fabsf(t[0] - 10 / 270.0F) < 1e-5F && fabsf(t[4] - 260 / 270.0F) < 1e-5F);
+    // backwards the same
+    n= gi.split_line(260, 62.5F, -10, 62.5F, 0.001F, t, 64);
+    ASSERT_TRUE(n == 5);
+    ASSERT_TRUE(fabsf(t[0] - 10 / 270.0F) < 1e-5F);
+
+    // a line not crossing anything is left alone
+    ASSERT_TRUE(gi.split_line(70, 70, 70, 70, 0.001F, t, 64) == 0);
+    ASSERT_TRUE(gi.split_line(70, 70, 100, 100, 1.0F, t, 64) == 0);
+
+    // diagonals, a long one over the whole bed and one that does not fit
+    const float tol= 0.002F;
+    for (int bicubic = 0; bicubic < 2; ++bicubic) {
+        gi.set_grid(grid, nx, ny, 0, 0, 62.5F, 62.5F, bicubic ? coeffs : nullptr);
+        n= gi.split_line(3, 240, 247, 11, tol, t, 64);
+        ASSERT_TRUE(n > 0);
+        for (int i = 1; i < n; ++i) ASSERT_TRUE(t[i] > t[i - 1]);
+        float worst= worst_chord_error(gi, 3, 240, 247, 11, t, n);
+        printf("GridInterpolator: %s 335mm diagonal in %d pieces (%d at 0.5mm), worst error %1.4fmm\n",
+            bicubic ? "bicubic" : "bilinear", n + 1, (int)ceilf(335 / 0.5F), worst);
+        ASSERT_TRUE(worst <= tol);
+
+        ASSERT_TRUE(gi.split_line(3, 240, 247, 11, tol / 1000, t, 8) == -1);
+
+        // a fan of lines at all angles, some running off the grid, all stay within tolerance
+        for (int k = 0; k < 24; ++k) {
+            float a= k * 0.2618F, r= 150;
+            float x1= 125 + r * cosf(a), y1= 125 + r * sinf(a);
+            float x2= 125 - r * cosf(a + 0.3F), y2= 125 - r * sinf(a + 0.3F);
+            n= gi.split_line(x1, y1, x2, y2, tol, t, 64);
+            ASSERT_TRUE(n >= 0);
+            ASSERT_TRUE(worst_chord_error(gi, x1, y1, x2, y2, t, n) <= tol);
+        }
+    }
+}